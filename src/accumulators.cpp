@@ -271,12 +271,12 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
 		}
 
 		//grab mints from this block
-		CBlock block;
-		if (!ReadBlockFromDisk(block, pindex))
+		CBlockRef pblock;
+		if (!ReadBlockFromDisk(pblock, pindex))
 			return error("%s: failed to read block from disk", __func__);
 
 		std::list<PublicCoin> listPubcoins;
-		if (!BlockToPubcoinList(block, listPubcoins, fFilterInvalid))
+		if (!BlockToPubcoinList(*pblock, listPubcoins, fFilterInvalid))
 			return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
 
 		nTotalMintsFound += listPubcoins.size();
@@ -353,7 +353,7 @@ int ComputeAccumulatedCoins(int nHeightEnd, libzerocoin::CoinDenomination denom)
 	CBlockIndex* pindex = chainActive[GetZerocoinStartHeight()];
 	int n = 0;
 	while (pindex->nHeight < nHeightEnd) {
-		n += count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), denom);
+		n += pindex->GetMintCount(denom);
 		pindex = chainActive.Next(pindex);
 	}
 
@@ -367,12 +367,12 @@ int AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nH
 	int nMintsAdded = 0;
 	if (pindex->MintedDenomination(coin.getDenomination())) {
 		//grab mints from this block
-		CBlock block;
-		if (!ReadBlockFromDisk(block, pindex))
+		CBlockRef pblock;
+		if (!ReadBlockFromDisk(pblock, pindex))
 			return error("%s: failed to read block from disk while adding pubcoins to witness", __func__);
 
 		list<PublicCoin> listPubcoins;
-		if (!BlockToPubcoinList(block, listPubcoins, true))
+		if (!BlockToPubcoinList(*pblock, listPubcoins, true))
 			return error("%s: failed to get zerocoin mintlist from block %n\n", __func__, pindex->nHeight);
 
 		//add the mints to the witness
@@ -547,8 +547,7 @@ map<CoinDenomination, int> GetMintMaturityHeight()
 		for (auto denom : libzerocoin::zerocoinDenomList) {
 			//If the denom has not already had a mint added to it, then see if it has a mint added on this block
 			if (mapDenomMaturity.at(denom).first < Params().Zerocoin_RequiredAccumulation()) {
-				mapDenomMaturity.at(denom).first += count(pindex->vMintDenominationsInBlock.begin(),
-					pindex->vMintDenominationsInBlock.end(), denom);
+				mapDenomMaturity.at(denom).first += pindex->GetMintCount(denom);
 
 				//if mint was found then record this block as the first block that maturity occurs.
 				if (mapDenomMaturity.at(denom).first >= Params().Zerocoin_RequiredAccumulation())
@@ -0,0 +1,87 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "serialize.h"
+#include "version.h"
+
+CBlockCache blockCache(DEFAULT_BLOCK_CACHE_SIZE << 20);
+
+CBlockCache::CBlockCache(size_t nMaxBytesIn) : nBytes(0), nMaxBytes(nMaxBytesIn), nHits(0), nMisses(0) {}
+
+CBlockRef CBlockCache::Get(const uint256& hash)
+{
+    LOCK(cs);
+    std::map<uint256, LRUList::iterator>::iterator it = mapBlocks.find(hash);
+    if (it == mapBlocks.end()) {
+        nMisses++;
+        return CBlockRef();
+    }
+    nHits++;
+    listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+    return it->second->second;
+}
+
+void CBlockCache::Insert(const CBlockRef& pblock)
+{
+    if (!pblock)
+        return;
+    size_t nSize = ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION);
+    const uint256 hash = pblock->GetHash();
+
+    LOCK(cs);
+    if (nSize > nMaxBytes)
+        return;
+    std::map<uint256, LRUList::iterator>::iterator it = mapBlocks.find(hash);
+    if (it != mapBlocks.end()) {
+        nBytes -= mapSizes[hash];
+        listBlocks.erase(it->second);
+    }
+    listBlocks.push_front(std::make_pair(hash, pblock));
+    mapBlocks[hash] = listBlocks.begin();
+    mapSizes[hash] = nSize;
+    nBytes += nSize;
+    EvictToSize();
+}
+
+void CBlockCache::EvictToSize()
+{
+    AssertLockHeld(cs);
+    while (nBytes > nMaxBytes && !listBlocks.empty()) {
+        const uint256& hash = listBlocks.back().first;
+        nBytes -= mapSizes[hash];
+        mapSizes.erase(hash);
+        mapBlocks.erase(hash);
+        listBlocks.pop_back();
+    }
+}
+
+void CBlockCache::SetMaxSize(size_t nMaxBytesIn)
+{
+    LOCK(cs);
+    nMaxBytes = nMaxBytesIn;
+    EvictToSize();
+}
+
+void CBlockCache::Clear()
+{
+    LOCK(cs);
+    listBlocks.clear();
+    mapBlocks.clear();
+    mapSizes.clear();
+    nBytes = 0;
+}
+
+CBlockCache::Stats CBlockCache::GetStats() const
+{
+    LOCK(cs);
+    Stats stats;
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    stats.nBlocks = listBlocks.size();
+    stats.nBytes = nBytes;
+    stats.nMaxBytes = nMaxBytes;
+    return stats;
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef Aratriton_BLOCKCACHE_H
+#define Aratriton_BLOCKCACHE_H
+
+#include "primitives/block.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <stdint.h>
+
+/** Default for -blockcachesize, in MiB of serialized block data */
+static const unsigned int DEFAULT_BLOCK_CACHE_SIZE = 16;
+
+typedef std::shared_ptr<const CBlock> CBlockRef;
+
+/**
+ * Size-bounded LRU cache of deserialized blocks, shared by everything that
+ * reads blocks from disk (peers, RPC, REST, ZMQ, accumulator code).
+ * Blocks are immutable once stored and handed out as shared pointers, so a
+ * block near the tip that is requested many times is read and parsed once.
+ */
+class CBlockCache
+{
+public:
+    struct Stats {
+        uint64_t nHits;
+        uint64_t nMisses;
+        size_t nBlocks;
+        size_t nBytes;
+        size_t nMaxBytes;
+    };
+
+private:
+    typedef std::list<std::pair<uint256, CBlockRef> > LRUList;
+
+    mutable CCriticalSection cs;
+    //! most recently used first
+    LRUList listBlocks;
+    std::map<uint256, LRUList::iterator> mapBlocks;
+    //! serialized size of each cached block
+    std::map<uint256, size_t> mapSizes;
+    size_t nBytes;
+    size_t nMaxBytes;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    void EvictToSize();
+
+public:
+    CBlockCache(size_t nMaxBytesIn);
+
+    //! Return the cached block with this hash (and mark it recently used), or NULL
+    CBlockRef Get(const uint256& hash);
+
+    //! Add a block; it replaces an existing entry for the same hash
+    void Insert(const CBlockRef& pblock);
+
+    //! Change the size limit, evicting as necessary; 0 disables the cache
+    void SetMaxSize(size_t nMaxBytesIn);
+
+    void Clear();
+
+    Stats GetStats() const;
+};
+
+extern CBlockCache blockCache;
+
+#endif // Aratriton_BLOCKCACHE_H
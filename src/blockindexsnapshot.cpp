@@ -0,0 +1,242 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexsnapshot.h"
+
+#include "accumulators.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "hash.h"
+#include "main.h"
+#include "mappedfile.h"
+#include "random.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+#include <boost/unordered_map.hpp>
+
+namespace {
+
+boost::filesystem::path GetSnapshotPath()
+{
+    return GetDataDir() / "blocks" / "index.snapshot";
+}
+
+/** One entry of the snapshot. Links to other entries are positions in the file, -1 for none. */
+class CSnapshotEntry
+{
+public:
+    uint256 hash;
+    int32_t nPrev;
+    int32_t nSkip;
+    CBlockIndex index;
+
+    CSnapshotEntry() : nPrev(-1), nSkip(-1) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(hash);
+        READWRITE(nPrev);
+        READWRITE(nSkip);
+        READWRITE(index.nHeight);
+        READWRITE(index.nFile);
+        READWRITE(index.nDataPos);
+        READWRITE(index.nUndoPos);
+        READWRITE(index.nChainWork);
+        READWRITE(index.nTx);
+        READWRITE(index.nChainTx);
+        READWRITE(index.nStatus);
+        READWRITE(index.nFlags);
+        READWRITE(index.nStakeModifier);
+        READWRITE(index.nStakeModifierChecksum);
+        READWRITE(index.prevoutStake);
+        READWRITE(index.nStakeTime);
+        READWRITE(index.nMint);
+        READWRITE(index.nMoneySupply);
+        READWRITE(index.nVersion);
+        READWRITE(index.hashMerkleRoot);
+        READWRITE(index.nTime);
+        READWRITE(index.nBits);
+        READWRITE(index.nNonce);
+        READWRITE(index.nAccumulatorCheckpoint);
+        for (int i = 0; i < libzerocoin::ZEROCOIN_DENOM_COUNT; i++) {
+            READWRITE(index.nZerocoinSupply[i]);
+            READWRITE(index.nMintsInBlock[i]);
+        }
+    }
+};
+
+} // anon namespace
+
+bool WriteBlockIndexSnapshot()
+{
+    AssertLockHeld(cs_main);
+    int64_t nStart = GetTimeMillis();
+
+    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
+    vSortedByHeight.reserve(mapBlockIndex.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex)
+        vSortedByHeight.push_back(std::make_pair(item.second->nHeight, item.second));
+    std::sort(vSortedByHeight.begin(), vSortedByHeight.end());
+
+    boost::unordered_map<const CBlockIndex*, int32_t> mapPosition;
+    for (size_t i = 0; i < vSortedByHeight.size(); i++)
+        mapPosition[vSortedByHeight[i].second] = i;
+
+    boost::filesystem::path path = GetSnapshotPath();
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".new";
+    CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s : failed to open %s", __func__, pathTmp.string());
+
+    uint256 id = GetRandHash();
+    uint64_t nEntries = vSortedByHeight.size();
+    long nChecksumPos;
+    try {
+        fileout << id << BLOCK_INDEX_SNAPSHOT_VERSION << Params().HashGenesisBlock() << nEntries;
+        nChecksumPos = ftell(fileout.Get());
+        fileout << uint256();
+
+        CHashWriter hasher(SER_DISK, CLIENT_VERSION);
+        for (const std::pair<int, CBlockIndex*>& item : vSortedByHeight) {
+            CSnapshotEntry entry;
+            entry.hash = item.second->GetBlockHash();
+            if (item.second->pprev)
+                entry.nPrev = mapPosition.at(item.second->pprev);
+            if (item.second->pskip)
+                entry.nSkip = mapPosition.at(item.second->pskip);
+            entry.index = *item.second;
+            fileout << entry;
+            hasher << entry;
+        }
+
+        if (nChecksumPos < 0 || fseek(fileout.Get(), nChecksumPos, SEEK_SET))
+            return error("%s : failed to seek in %s", __func__, pathTmp.string());
+        fileout << hasher.GetHash();
+    } catch (const std::exception& e) {
+        return error("%s : I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    if (!RenameOver(pathTmp, path))
+        return error("%s : failed to rename %s", __func__, pathTmp.string());
+    if (!pblocktree->WriteIndexSnapshotId(id))
+        return error("%s : failed to record the snapshot id", __func__);
+
+    LogPrintf("Wrote block index snapshot with %u entries in %dms\n", nEntries, GetTimeMillis() - nStart);
+    return true;
+}
+
+bool LoadBlockIndexSnapshot(std::vector<std::pair<int, CBlockIndex*> >& vSortedByHeight)
+{
+    AssertLockHeld(cs_main);
+    int64_t nStart = GetTimeMillis();
+
+    boost::filesystem::path path = GetSnapshotPath();
+    if (!boost::filesystem::exists(path))
+        return false;
+
+    // The id is erased whatever happens next, the snapshot is good for one start only
+    uint256 idExpected;
+    bool fHaveId = pblocktree->ReadIndexSnapshotId(idExpected);
+    if (fHaveId && !pblocktree->EraseIndexSnapshotId())
+        return error("%s : failed to erase the snapshot id", __func__);
+
+    std::vector<CBlockIndex*> vIndex;
+    std::vector<uint256> vHash;
+    {
+        if (!fHaveId) {
+            LogPrintf("%s : block index snapshot is stale, loading the block index database\n", __func__);
+            return false;
+        }
+
+        // Read the whole file where it cannot be mapped
+        CMappedFile file(path);
+        std::vector<char> vBuffer;
+        const char* pbegin = file.begin();
+        const char* pend = file.end();
+        if (file.IsNull()) {
+            CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+            if (filein.IsNull())
+                return error("%s : failed to open %s", __func__, path.string());
+            vBuffer.resize(boost::filesystem::file_size(path));
+            try {
+                filein.read(vBuffer.data(), vBuffer.size());
+            } catch (const std::exception& e) {
+                return error("%s : I/O error - %s", __func__, e.what());
+            }
+            pbegin = vBuffer.data();
+            pend = vBuffer.data() + vBuffer.size();
+        }
+
+        try {
+            CMemoryReader reader(pbegin, pend, SER_DISK, CLIENT_VERSION);
+            uint256 id, hashGenesis, hashChecksum;
+            unsigned int nVersion;
+            uint64_t nEntries;
+            reader >> id >> nVersion >> hashGenesis >> nEntries >> hashChecksum;
+            if (id != idExpected || nVersion != BLOCK_INDEX_SNAPSHOT_VERSION || hashGenesis != Params().HashGenesisBlock()) {
+                LogPrintf("%s : block index snapshot is stale, loading the block index database\n", __func__);
+                return false;
+            }
+            if (Hash(pend - reader.size(), pend) != hashChecksum)
+                return error("%s : block index snapshot checksum mismatch", __func__);
+
+            vIndex.reserve(nEntries);
+            vHash.reserve(nEntries);
+            for (uint64_t i = 0; i < nEntries; i++) {
+                CSnapshotEntry entry;
+                reader >> entry;
+                if (entry.nPrev >= (int64_t)i || entry.nSkip >= (int64_t)i)
+                    throw std::runtime_error("entry links forward");
+
+                CBlockIndex* pindexNew = new CBlockIndex(entry.index);
+                vIndex.push_back(pindexNew);
+                vHash.push_back(entry.hash);
+                pindexNew->phashBlock = NULL;
+                pindexNew->pprev = entry.nPrev >= 0 ? vIndex[entry.nPrev] : NULL;
+                pindexNew->pskip = entry.nSkip >= 0 ? vIndex[entry.nSkip] : NULL;
+                pindexNew->pnext = NULL;
+                pindexNew->nSequenceId = 0;
+            }
+            if (!reader.empty())
+                throw std::runtime_error("trailing data");
+        } catch (const std::exception& e) {
+            for (CBlockIndex* pindex : vIndex)
+                delete pindex;
+            return error("%s : Deserialize error - %s", __func__, e.what());
+        }
+    }
+
+    mapBlockIndex.reserve(mapBlockIndex.size() + vIndex.size());
+    vSortedByHeight.reserve(vIndex.size());
+    uint256 nPreviousCheckpoint;
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        CBlockIndex* pindex = vIndex[i];
+        BlockMap::iterator mi = mapBlockIndex.insert(std::make_pair(vHash[i], pindex)).first;
+        pindex->phashBlock = &mi->first;
+        vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
+
+        // The same side effects as CBlockTreeDB::LoadBlockIndexGuts
+        if (pindex->IsProofOfStake())
+            setStakeSeen.insert(std::make_pair(pindex->prevoutStake, pindex->nStakeTime));
+        if (pindex->nAccumulatorCheckpoint != 0 && pindex->nAccumulatorCheckpoint != nPreviousCheckpoint) {
+            if (pindex->nHeight >= Params().Zerocoin_Block_V2_Start())
+                LoadAccumulatorValuesFromDB(pindex->nAccumulatorCheckpoint);
+            nPreviousCheckpoint = pindex->nAccumulatorCheckpoint;
+        }
+    }
+
+    LogPrintf("Loaded block index snapshot with %u entries in %dms\n", vIndex.size(), GetTimeMillis() - nStart);
+    return true;
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef Aratriton_BLOCKINDEXSNAPSHOT_H
+#define Aratriton_BLOCKINDEXSNAPSHOT_H
+
+#include <utility>
+#include <vector>
+
+class CBlockIndex;
+
+/** Default for -blockindexsnapshot */
+static const bool DEFAULT_BLOCK_INDEX_SNAPSHOT = true;
+
+/** Format version of blocks/index.snapshot */
+static const unsigned int BLOCK_INDEX_SNAPSHOT_VERSION = 1;
+
+/**
+ * The block index snapshot is a flat file holding every entry of mapBlockIndex
+ * as it is after loading: chain work, transaction counts and skip pointers
+ * included, ordered by height with links stored as positions in the file.
+ * It is written on a clean shutdown and is only trusted on the next start
+ * if the id stored with it matches the one recorded in the block tree
+ * database. That id is erased as soon as the snapshot has been loaded, so any
+ * change to the database afterwards leaves the snapshot stale and LevelDB is
+ * used instead.
+ */
+
+/** Write the snapshot of mapBlockIndex and record its id in the block tree database */
+bool WriteBlockIndexSnapshot();
+
+/**
+ * Fill mapBlockIndex from the snapshot, if there is a valid one. On success
+ * vSortedByHeight holds the loaded entries ordered by height, and nChainWork,
+ * nChainTx and pskip are already set. Returns false (leaving mapBlockIndex
+ * untouched) if the snapshot is missing, stale or corrupt.
+ */
+bool LoadBlockIndexSnapshot(std::vector<std::pair<int, CBlockIndex*> >& vSortedByHeight);
+
+#endif // Aratriton_BLOCKINDEXSNAPSHOT_H
@@ -15,6 +15,10 @@
 #include "util.h"
 #include "libzerocoin/Denominations.h"
 
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+#include <map>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -121,9 +125,6 @@ public:
     //! pointer to the index of some further predecessor of this block
     CBlockIndex* pskip;
 
-    //ppcoin: trust score of block chain
-    uint256 bnChainTrust;
-
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight;
 
@@ -164,7 +165,6 @@ public:
     unsigned int nStakeModifierChecksum; // checksum of index; in-memeory only
     COutPoint prevoutStake;
     unsigned int nStakeTime;
-    uint256 hashProofOfStake;
     int64_t nMint;
     int64_t nMoneySupply;
 
@@ -179,10 +179,11 @@ public:
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     uint32_t nSequenceId;
     
-    //! zerocoin specific fields
-    std::map<libzerocoin::CoinDenomination, int64_t> mapZerocoinSupply;
-    std::vector<libzerocoin::CoinDenomination> vMintDenominationsInBlock;
-    
+    //! zerocoin specific fields, indexed by the position of the denomination in zerocoinDenomList.
+    //! Fixed arrays instead of a map and a vector keep every entry of mapBlockIndex free of extra allocations.
+    int64_t nZerocoinSupply[libzerocoin::ZEROCOIN_DENOM_COUNT];
+    uint16_t nMintsInBlock[libzerocoin::ZEROCOIN_DENOM_COUNT];
+
     void SetNull()
     {
         phashBlock = NULL;
@@ -213,10 +214,8 @@ public:
         nNonce = 0;
         nAccumulatorCheckpoint = 0;
         // Start supply of each denomination with 0s
-        for (auto& denom : libzerocoin::zerocoinDenomList) {
-            mapZerocoinSupply.insert(make_pair(denom, 0));
-        }
-        vMintDenominationsInBlock.clear();
+        std::fill(nZerocoinSupply, nZerocoinSupply + libzerocoin::ZEROCOIN_DENOM_COUNT, 0);
+        ClearMints();
     }
 
     CBlockIndex()
@@ -237,13 +236,11 @@ public:
             nAccumulatorCheckpoint = block.nAccumulatorCheckpoint;
 
         //Proof of Stake
-        bnChainTrust = uint256();
         nMint = 0;
         nMoneySupply = 0;
         nFlags = 0;
         nStakeModifier = 0;
         nStakeModifierChecksum = 0;
-        hashProofOfStake = uint256();
 
         if (block.IsProofOfStake()) {
             SetProofOfStake();
@@ -294,14 +291,64 @@ public:
     {
         int64_t nTotal = 0;
         for (auto& denom : libzerocoin::zerocoinDenomList) {
-            nTotal += libzerocoin::ZerocoinDenominationToAmount(denom) * mapZerocoinSupply.at(denom);
+            nTotal += libzerocoin::ZerocoinDenominationToAmount(denom) * GetZerocoinSupply(denom);
         }
         return nTotal;
     }
 
+    int64_t GetZerocoinSupply(libzerocoin::CoinDenomination denom) const
+    {
+        return nZerocoinSupply[DenominationIndex(denom)];
+    }
+
+    void SetZerocoinSupply(libzerocoin::CoinDenomination denom, int64_t nSupply)
+    {
+        nZerocoinSupply[DenominationIndex(denom)] = nSupply;
+    }
+
+    //! Copy the supply of every denomination from another index entry
+    void SetZerocoinSupply(const CBlockIndex* pindexFrom)
+    {
+        std::copy(pindexFrom->nZerocoinSupply, pindexFrom->nZerocoinSupply + libzerocoin::ZEROCOIN_DENOM_COUNT, nZerocoinSupply);
+    }
+
+    //! Number of mints of this denomination in the block
+    int GetMintCount(libzerocoin::CoinDenomination denom) const
+    {
+        return nMintsInBlock[DenominationIndex(denom)];
+    }
+
     bool MintedDenomination(libzerocoin::CoinDenomination denom) const
     {
-        return std::find(vMintDenominationsInBlock.begin(), vMintDenominationsInBlock.end(), denom) != vMintDenominationsInBlock.end();
+        return GetMintCount(denom) > 0;
+    }
+
+    void AddMint(libzerocoin::CoinDenomination denom)
+    {
+        uint16_t& nCount = nMintsInBlock[DenominationIndex(denom)];
+        if (nCount < std::numeric_limits<uint16_t>::max())
+            nCount++;
+    }
+
+    void ClearMints()
+    {
+        std::fill(nMintsInBlock, nMintsInBlock + libzerocoin::ZEROCOIN_DENOM_COUNT, 0);
+    }
+
+    //! Mints of the block in the order of zerocoinDenomList, one entry per mint
+    std::vector<libzerocoin::CoinDenomination> GetMintDenominations() const
+    {
+        std::vector<libzerocoin::CoinDenomination> vDenoms;
+        for (auto& denom : libzerocoin::zerocoinDenomList)
+            vDenoms.insert(vDenoms.end(), GetMintCount(denom), denom);
+        return vDenoms;
+    }
+
+    static int DenominationIndex(libzerocoin::CoinDenomination denom)
+    {
+        int nIndex = libzerocoin::ZerocoinDenominationToIndex(denom);
+        assert(nIndex >= 0);
+        return nIndex;
     }
 
     uint256 GetBlockHash() const
@@ -467,7 +514,6 @@ public:
         } else {
             const_cast<CDiskBlockIndex*>(this)->prevoutStake.SetNull();
             const_cast<CDiskBlockIndex*>(this)->nStakeTime = 0;
-            const_cast<CDiskBlockIndex*>(this)->hashProofOfStake = uint256();
         }
 
         // block header
@@ -480,8 +526,28 @@ public:
         READWRITE(nNonce);
         if(this->nVersion > 3) {
             READWRITE(nAccumulatorCheckpoint);
+
+            // The disk format keeps the map of supplies and the list of minted denominations
+            std::map<libzerocoin::CoinDenomination, int64_t> mapZerocoinSupply;
+            std::vector<libzerocoin::CoinDenomination> vMintDenominationsInBlock;
+            if (!ser_action.ForRead()) {
+                for (auto& denom : libzerocoin::zerocoinDenomList)
+                    mapZerocoinSupply[denom] = GetZerocoinSupply(denom);
+                vMintDenominationsInBlock = GetMintDenominations();
+            }
             READWRITE(mapZerocoinSupply);
             READWRITE(vMintDenominationsInBlock);
+            if (ser_action.ForRead()) {
+                for (auto& item : mapZerocoinSupply) {
+                    if (libzerocoin::ZerocoinDenominationToIndex(item.first) >= 0)
+                        SetZerocoinSupply(item.first, item.second);
+                }
+                ClearMints();
+                for (auto& denom : vMintDenominationsInBlock) {
+                    if (libzerocoin::ZerocoinDenominationToIndex(denom) >= 0)
+                        AddMint(denom);
+                }
+            }
         }
 
     }
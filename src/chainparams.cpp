@@ -183,6 +183,9 @@ public:
         assert(hashGenesisBlock == uint256("0x00000fc630a7ded957563e9bd478de331a31c410091c4aa9b70525a24ba5958e"));
         assert(genesis.hashMerkleRoot == uint256("0xf01e124f1c53d746223d5929c30e059de726a3ffea70c7b89fa24dd4faa4cca9"));
 
+        // The last checkpoint
+        hashDefaultAssumeValid = uint256("0xf952fcc8088db8c21286e6e8d021af16eeba47a3777759d03cead2ca01769c12");
+
         vSeeds.push_back(CDNSSeedData("0", "dnsseeder.aratriton.com"));
 		vSeeds.push_back(CDNSSeedData("1", "explorer.aratriton.com"));
 		vSeeds.push_back(CDNSSeedData("2", "dnsseed1.aratriton.com"));
@@ -382,6 +385,7 @@ public:
 
         hashGenesisBlock = genesis.GetHash();
         //assert(hashGenesisBlock == uint256("0x0000041e482b9b9691d98eefb48473405c0b8ec31b76df3797c74a78680ef818"));
+        hashDefaultAssumeValid = uint256();
 
         vFixedSeeds.clear();
         vSeeds.clear();
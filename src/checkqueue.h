@@ -1,207 +1,250 @@
 // Copyright (c) 2012-2014 The Bitcoin developers
+// Copyright (c) 2019 The Aratriton developers
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #ifndef BITCOIN_CHECKQUEUE_H
 #define BITCOIN_CHECKQUEUE_H
 
-#include <algorithm>
+#include <assert.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <vector>
 
-#include <boost/foreach.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 
-template <typename T>
 class CCheckQueueControl;
 
-/** 
- * Queue for verifications that have to be performed.
-  * The verifications are represented by a type T, which must provide an
-  * operator(), returning a bool.
-  *
-  * One thread (the master) is assumed to push batches of verifications
-  * onto the queue, where they are processed by N-1 worker threads. When
-  * the master is done adding work, it temporarily joins the worker pool
-  * as an N'th worker, until all jobs are done.
-  */
-template <typename T>
+/**
+ * Pool of threads for verifications that have to be performed.
+ * A verification is any job returning a bool: script checks, zerocoin spend
+ * signatures, or whatever else can run without holding cs_main. Jobs belong
+ * to a CCheckQueueControl, which collects their results, so any number of
+ * blocks and transactions can be verified through the pool at once.
+ *
+ * Every worker thread has its own deque of jobs. New jobs are spread over the
+ * deques; a worker takes jobs from the back of its own deque and, once that
+ * is empty, steals from the front of the others'. A thread waiting for its
+ * control to finish helps out the same way until its jobs are done.
+ */
 class CCheckQueue
 {
-private:
-    //! Mutex to protect the inner state
-    boost::mutex mutex;
-
-    //! Worker threads block on this when out of work
-    boost::condition_variable condWorker;
-
-    //! Master thread blocks on this when out of work
-    boost::condition_variable condMaster;
-
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
-
-    //! The number of workers (including the master) that are idle.
-    int nIdle;
-
-    //! The total number of workers (including the master).
-    int nTotal;
+public:
+    struct CJob {
+        CCheckQueueControl* pcontrol;
+        std::function<bool()> check;
+    };
 
-    //! The temporary evaluation result.
-    bool fAllOk;
+private:
+    struct CWorkerQueue {
+        boost::mutex mutex;
+        std::deque<CJob> jobs;
+    };
 
-    /**
-     * Number of verifications that haven't completed yet.
-     * This includes elements that are not anymore in queue, but still in
-     * worker's own batches.
-     */
-    unsigned int nTodo;
+    //! Slot 0 takes the jobs while no worker has started, slots 1..n belong to the workers
+    std::vector<std::unique_ptr<CWorkerQueue> > vQueues;
+    std::atomic<int> nWorkers;
+    std::atomic<unsigned int> nNextQueue;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! Idle workers block on this until jobs are queued
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    //! Jobs sitting in a deque, not taken by any thread yet
+    int nQueued;
 
-    //! The maximum number of elements to be processed in one batch
-    unsigned int nBatchSize;
+    bool TryPop(int nId, CJob& job)
+    {
+        CWorkerQueue& queue = *vQueues[nId];
+        boost::unique_lock<boost::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+            return false;
+        job = std::move(queue.jobs.back());
+        queue.jobs.pop_back();
+        return true;
+    }
 
-    /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool TrySteal(int nId, CJob& job)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
-        std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
-        do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master he can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
-            }
-            // execute work
-            BOOST_FOREACH (T& check, vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
-        } while (true);
+        int nQueues = nWorkers + 1;
+        for (int i = 1; i <= nQueues; i++) {
+            CWorkerQueue& queue = *vQueues[(nId + i) % nQueues];
+            boost::unique_lock<boost::mutex> lock(queue.mutex);
+            if (queue.jobs.empty())
+                continue;
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            return true;
+        }
+        return false;
     }
 
+    void Run(CJob& job);
+
 public:
-    //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    //! Create a new check queue for at most nMaxWorkers worker threads
+    CCheckQueue(int nMaxWorkers) : nWorkers(0), nNextQueue(0), nQueued(0)
+    {
+        for (int i = 0; i <= nMaxWorkers; i++)
+            vQueues.push_back(std::unique_ptr<CWorkerQueue>(new CWorkerQueue()));
+    }
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        int nId;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            assert(nWorkers + 1 < (int)vQueues.size());
+            nId = ++nWorkers;
+        }
+        while (true) {
+            CJob job;
+            if (TryPop(nId, job) || TrySteal(nId, job)) {
+                {
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    nQueued--;
+                }
+                Run(job);
+                continue;
+            }
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (nQueued <= 0)
+                condWorker.wait(lock); // interruption point on shutdown
+        }
     }
 
-    //! Wait until execution finishes, and return whether all evaluations where successful.
-    bool Wait()
+    //! Queue jobs, spread over the workers' deques
+    void Add(std::vector<CJob>& vJobs)
     {
-        return Loop(true);
-    }
-
-    //! Add a batch of checks to the queue
-    void Add(std::vector<T>& vChecks)
-    {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        BOOST_FOREACH (T& check, vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
+        if (vJobs.empty())
+            return;
+        int nQueues = nWorkers;
+        for (CJob& job : vJobs) {
+            CWorkerQueue& queue = *vQueues[nQueues ? 1 + nNextQueue++ % nQueues : 0];
+            boost::unique_lock<boost::mutex> lock(queue.mutex);
+            queue.jobs.push_back(std::move(job));
         }
-        nTodo += vChecks.size();
-        if (vChecks.size() == 1)
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nQueued += vJobs.size();
+        }
+        if (vJobs.size() == 1)
             condWorker.notify_one();
-        else if (vChecks.size() > 1)
+        else
             condWorker.notify_all();
     }
 
-    ~CCheckQueue()
-    {
-    }
-
-    bool IsIdle()
+    //! Run one queued job of any control from the calling thread. Returns false if there was none.
+    bool Help()
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        return (nTotal == nIdle && nTodo == 0 && fAllOk == true);
+        CJob job;
+        if (!TrySteal(nNextQueue++, job))
+            return false;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nQueued--;
+        }
+        Run(job);
+        return true;
     }
 };
 
-/** 
- * RAII-style controller object for a CCheckQueue that guarantees the passed
- * queue is finished before continuing.
+/**
+ * RAII-style collector for a set of jobs run on a CCheckQueue. Wait() returns
+ * whether all of them passed; jobs added after one failed are skipped. The
+ * destructor waits for any jobs still running. With no queue, jobs given as
+ * functions run right away and checks given as vectors are dropped, as those
+ * are only created when there is a queue to run them.
  */
-template <typename T>
 class CCheckQueueControl
 {
 private:
-    CCheckQueue<T>* pqueue;
+    friend class CCheckQueue;
+
+    CCheckQueue* pqueue;
+    std::atomic<bool> fAllOk;
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    //! Jobs added and not finished yet, guarded by mutex
+    unsigned int nTodo;
     bool fDone;
 
-public:
-    CCheckQueueControl(CCheckQueue<T>* pqueueIn) : pqueue(pqueueIn), fDone(false)
+    void Done(bool fOk)
     {
-        // passed queue is supposed to be unused, or NULL
-        if (pqueue != NULL) {
-            bool isIdle = pqueue->IsIdle();
-            assert(isIdle);
+        if (!fOk)
+            fAllOk = false;
+        // The decrement happens under the lock, so Wait() cannot return while this still uses the control
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (--nTodo == 0)
+            cond.notify_all();
+    }
+
+    void AddJobs(std::vector<CCheckQueue::CJob>& vJobs)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            nTodo += vJobs.size();
         }
+        pqueue->Add(vJobs);
     }
 
+public:
+    CCheckQueueControl(CCheckQueue* pqueueIn) : pqueue(pqueueIn), fAllOk(true), nTodo(0), fDone(false) {}
+
     bool Wait()
     {
-        if (pqueue == NULL)
-            return true;
-        bool fRet = pqueue->Wait();
+        if (pqueue != NULL) {
+            while (true) {
+                {
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    if (nTodo == 0)
+                        break;
+                }
+                if (!pqueue->Help()) {
+                    // What is left of ours is running on other threads
+                    boost::unique_lock<boost::mutex> lock(mutex);
+                    while (nTodo != 0)
+                        cond.wait(lock);
+                    break;
+                }
+            }
+        }
         fDone = true;
-        return fRet;
+        return fAllOk;
     }
 
+    //! Add a batch of checks, each swapped out of vChecks into a job
+    template <typename T>
     void Add(std::vector<T>& vChecks)
     {
-        if (pqueue != NULL)
-            pqueue->Add(vChecks);
+        if (pqueue == NULL || vChecks.empty())
+            return;
+        std::vector<CCheckQueue::CJob> vJobs(vChecks.size());
+        for (size_t i = 0; i < vChecks.size(); i++) {
+            std::shared_ptr<T> pcheck = std::make_shared<T>();
+            pcheck->swap(vChecks[i]);
+            vJobs[i].pcontrol = this;
+            vJobs[i].check = [pcheck]() { return (*pcheck)(); };
+        }
+        AddJobs(vJobs);
+    }
+
+    //! Add a single job of any kind
+    void Add(const std::function<bool()>& check)
+    {
+        if (pqueue == NULL) {
+            if (fAllOk && !check())
+                fAllOk = false;
+            return;
+        }
+        std::vector<CCheckQueue::CJob> vJobs(1);
+        vJobs[0].pcontrol = this;
+        vJobs[0].check = check;
+        AddJobs(vJobs);
     }
 
     ~CCheckQueueControl()
@@ -211,4 +254,11 @@ public:
     }
 };
 
+inline void CCheckQueue::Run(CJob& job)
+{
+    // Once a check of this control failed the result is settled, skip the rest
+    bool fOk = job.pcontrol->fAllOk && job.check();
+    job.pcontrol->Done(fOk);
+}
+
 #endif // BITCOIN_CHECKQUEUE_H
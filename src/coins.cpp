@@ -8,6 +8,7 @@
 
 #include "random.h"
 
+#include <algorithm>
 #include <assert.h>
 
 /**
@@ -178,6 +179,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlockIn
                     assert(it->second.flags & CCoinsCacheEntry::FRESH);
                     CCoinsCacheEntry& entry = cacheCoins[it->first];
                     entry.coins.swap(it->second.coins);
+                    entry.vDirtyOutputs.swap(it->second.vDirtyOutputs);
                     entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
                 }
             } else {
@@ -189,6 +191,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlockIn
                 } else {
                     // A normal modification.
                     itUs->second.coins.swap(it->second.coins);
+                    itUs->second.MergeDirtyOutputs(it->second);
                     itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                 }
             }
@@ -269,6 +272,14 @@ CCoinsModifier::CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_)
 {
     assert(!cache.hasModifier);
     cache.hasModifier = true;
+    const CCoins& coins = it->second.coins;
+    vAvailableBefore.resize(coins.vout.size());
+    for (unsigned int i = 0; i < coins.vout.size(); i++)
+        vAvailableBefore[i] = !coins.vout[i].IsNull();
+    nHeightBefore = coins.nHeight;
+    nVersionBefore = coins.nVersion;
+    fCoinBaseBefore = coins.fCoinBase;
+    fCoinStakeBefore = coins.fCoinStake;
 }
 
 CCoinsModifier::~CCoinsModifier()
@@ -278,5 +289,18 @@ CCoinsModifier::~CCoinsModifier()
     it->second.coins.Cleanup();
     if ((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
         cache.cacheCoins.erase(it);
+        return;
+    }
+
+    // Remember which outputs changed, so that flushing only touches those
+    const CCoins& coins = it->second.coins;
+    bool fMetadataChanged = coins.nHeight != nHeightBefore || coins.nVersion != nVersionBefore ||
+                            coins.fCoinBase != fCoinBaseBefore || coins.fCoinStake != fCoinStakeBefore;
+    unsigned int nOutputs = std::max((unsigned int)vAvailableBefore.size(), (unsigned int)coins.vout.size());
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        bool fBefore = i < vAvailableBefore.size() && vAvailableBefore[i];
+        bool fAfter = i < coins.vout.size() && !coins.vout[i].IsNull();
+        if (fBefore != fAfter || (fAfter && fMetadataChanged))
+            it->second.SetOutputDirty(i);
     }
 }
@@ -310,12 +310,41 @@ struct CCoinsCacheEntry {
     CCoins coins; // The actual cached data.
     unsigned char flags;
 
+    /**
+     * Outputs whose availability (or metadata) may differ from the version in
+     * the parent view. The chainstate database stores one record per output,
+     * so only these have to be written or erased when the entry is flushed.
+     */
+    std::vector<bool> vDirtyOutputs;
+
     enum Flags {
         DIRTY = (1 << 0), // This cache entry is potentially different from the version in the parent view.
         FRESH = (1 << 1), // The parent view does not have this entry (or it is pruned).
     };
 
     CCoinsCacheEntry() : coins(), flags(0) {}
+
+    //! check whether output nPos may differ from the parent view
+    bool IsOutputDirty(unsigned int nPos) const
+    {
+        return nPos < vDirtyOutputs.size() && vDirtyOutputs[nPos];
+    }
+
+    //! mark output nPos as possibly different from the parent view
+    void SetOutputDirty(unsigned int nPos)
+    {
+        if (vDirtyOutputs.size() <= nPos)
+            vDirtyOutputs.resize(nPos + 1, false);
+        vDirtyOutputs[nPos] = true;
+    }
+
+    //! merge the dirty outputs of a child cache entry into this one
+    void MergeDirtyOutputs(const CCoinsCacheEntry& child)
+    {
+        for (unsigned int i = 0; i < child.vDirtyOutputs.size(); i++)
+            if (child.vDirtyOutputs[i])
+                SetOutputDirty(i);
+    }
 };
 
 typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
@@ -400,6 +429,14 @@ class CCoinsModifier
 private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
+
+    //! availability of each output and the metadata before the modification, to find the outputs that changed
+    std::vector<bool> vAvailableBefore;
+    int nHeightBefore;
+    int nVersionBefore;
+    bool fCoinBaseBefore;
+    bool fCoinStakeBefore;
+
     CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_);
 
 public:
@@ -0,0 +1,159 @@
+// Copyright (c) 2016 Jeremy Rubin
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef Aratriton_CUCKOOCACHE_H
+#define Aratriton_CUCKOOCACHE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+/**
+ * A fixed size set of hashes, laid out as a cuckoo hash table.
+ *
+ * Every element has eight candidate slots, picked by eight hash functions
+ * supplied by the Hash type. Inserting into a full neighbourhood moves the
+ * occupant of one slot to one of its own alternatives, up to a depth limit,
+ * after which the last displaced element is dropped. Nothing is ever
+ * allocated after setup, so the memory used is exactly what was asked for.
+ *
+ * Lookups only read the table and may run concurrently with each other.
+ * An element found by a lookup can be marked as erasable; the mark is an
+ * atomic bit, so erasing needs no exclusive access either. The slot is reused
+ * by the next insert that lands on it. Inserts must not run concurrently with
+ * anything else.
+ */
+namespace CuckooCache
+{
+/** One atomically settable bit per slot, set when the slot may be overwritten */
+class bit_packed_atomic_flags
+{
+private:
+    std::unique_ptr<std::atomic<uint8_t>[]> mem;
+
+public:
+    bit_packed_atomic_flags() {}
+
+    void setup(uint32_t b)
+    {
+        uint32_t nBytes = (b + 7) / 8;
+        mem.reset(new std::atomic<uint8_t>[nBytes]);
+        for (uint32_t i = 0; i < nBytes; ++i)
+            mem[i].store(0xFF);
+    }
+
+    void bit_set(uint32_t s) { mem[s >> 3].fetch_or(1 << (s & 7), std::memory_order_relaxed); }
+    void bit_unset(uint32_t s) { mem[s >> 3].fetch_and(~(1 << (s & 7)), std::memory_order_relaxed); }
+    bool bit_is_set(uint32_t s) const { return (1 << (s & 7)) & mem[s >> 3].load(std::memory_order_relaxed); }
+};
+
+/**
+ * Element must be default constructible and comparable; Hash must provide
+ * template <uint8_t n> uint32_t operator()(const Element&) const for n in 0..7,
+ * returning independent, uniformly distributed values (for salted hashes,
+ * slices of the hash itself will do).
+ */
+template <typename Element, typename Hash>
+class cache
+{
+private:
+    std::vector<Element> table;
+    uint32_t size;
+    //! Set for slots that hold nothing, or an element that may be overwritten
+    mutable bit_packed_atomic_flags collection_flags;
+    uint8_t depth_limit;
+    const Hash hash_function;
+
+    std::array<uint32_t, 8> compute_hashes(const Element& e) const
+    {
+        // Map each 32 bit hash onto [0, size) without a division
+        return {{(uint32_t)(((uint64_t)hash_function.template operator()<0>(e) * (uint64_t)size) >> 32),
+            (uint32_t)(((uint64_t)hash_function.template operator()<1>(e) * (uint64_t)size) >> 32),
+            (uint32_t)(((uint64_t)hash_function.template operator()<2>(e) * (uint64_t)size) >> 32),
+            (uint32_t)(((uint64_t)hash_function.template operator()<3>(e) * (uint64_t)size) >> 32),
+            (uint32_t)(((uint64_t)hash_function.template operator()<4>(e) * (uint64_t)size) >> 32),
+            (uint32_t)(((uint64_t)hash_function.template operator()<5>(e) * (uint64_t)size) >> 32),
+            (uint32_t)(((uint64_t)hash_function.template operator()<6>(e) * (uint64_t)size) >> 32),
+            (uint32_t)(((uint64_t)hash_function.template operator()<7>(e) * (uint64_t)size) >> 32)}};
+    }
+
+    static constexpr uint32_t invalid() { return ~(uint32_t)0; }
+
+public:
+    cache() : size(0), depth_limit(0), hash_function() {}
+
+    /** Size the table for at most new_size elements. Drops whatever was in it. Returns the number of slots. */
+    uint32_t setup(uint32_t new_size)
+    {
+        size = std::max<uint32_t>(2, new_size);
+        // log2(size) moves are enough to find a free slot with high probability
+        depth_limit = 0;
+        for (uint32_t n = size; n; n >>= 1)
+            ++depth_limit;
+        table.assign(size, Element());
+        collection_flags.setup(size);
+        return size;
+    }
+
+    /** Size the table to use at most bytes of memory for elements. Returns the number of slots. */
+    uint32_t setup_bytes(size_t bytes)
+    {
+        return setup(std::min<size_t>(bytes / sizeof(Element), invalid() - 1));
+    }
+
+    /** Add e to the cache, possibly dropping an older element. Needs exclusive access. */
+    void insert(Element e)
+    {
+        if (size == 0)
+            return;
+        uint32_t last_loc = invalid();
+        std::array<uint32_t, 8> locs = compute_hashes(e);
+        // Already present: keep it and make sure it is not collected
+        for (const uint32_t loc : locs) {
+            if (table[loc] == e) {
+                collection_flags.bit_unset(loc);
+                return;
+            }
+        }
+        for (uint8_t depth = 0; depth < depth_limit; ++depth) {
+            for (const uint32_t loc : locs) {
+                if (!collection_flags.bit_is_set(loc))
+                    continue;
+                table[loc] = std::move(e);
+                collection_flags.bit_unset(loc);
+                return;
+            }
+            // Every candidate is taken: displace the occupant of the slot after the one we
+            // came from, so that a displaced element does not bounce straight back
+            last_loc = locs[(1 + (std::find(locs.begin(), locs.end(), last_loc) - locs.begin())) & 7];
+            std::swap(table[last_loc], e);
+            locs = compute_hashes(e);
+        }
+        // e is the element that fell off the end of the chain
+    }
+
+    /** Whether e is in the cache. If erase is set, its slot is freed for reuse. Safe to call concurrently. */
+    bool contains(const Element& e, const bool erase) const
+    {
+        if (size == 0)
+            return false;
+        std::array<uint32_t, 8> locs = compute_hashes(e);
+        for (const uint32_t loc : locs) {
+            if (table[loc] == e && !collection_flags.bit_is_set(loc)) {
+                if (erase)
+                    collection_flags.bit_set(loc);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+} // namespace CuckooCache
+
+#endif // Aratriton_CUCKOOCACHE_H
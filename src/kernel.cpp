@@ -6,7 +6,10 @@
 
 #include <boost/assign/list_of.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
 
+#include "checkqueue.h"
 #include "db.h"
 #include "kernel.h"
 #include "script/interpreter.h"
@@ -244,32 +247,92 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
 
 // The stake modifier used to hash for a stake kernel is chosen as the stake
 // modifier about a selection interval later than the coin generating the kernel
+// The blocks of the active chain that generated a stake modifier, in height
+// order. Block times are not monotonic along the chain, so next to each block
+// the index keeps the latest time of any block up to it, which is.
+class CStakeModifierIndex
+{
+private:
+    std::vector<const CBlockIndex*> vBlocks;
+    std::vector<int64_t> vMaxTime;
+    const CBlockIndex* pindexSynced;
+
+public:
+    CStakeModifierIndex() : pindexSynced(NULL) {}
+
+    // Follow the chain to its tip: drop what is no longer on it, then add the
+    // new blocks. Usually that is one block connected or disconnected.
+    void Sync(const CChain& chain)
+    {
+        if (pindexSynced == chain.Tip())
+            return;
+
+        const CBlockIndex* pindexFork = pindexSynced ? chain.FindFork(pindexSynced) : NULL;
+        int nForkHeight = pindexFork ? pindexFork->nHeight : -1;
+        while (!vBlocks.empty() && vBlocks.back()->nHeight > nForkHeight) {
+            vBlocks.pop_back();
+            vMaxTime.pop_back();
+        }
+
+        for (int nHeight = nForkHeight + 1; nHeight <= chain.Height(); nHeight++) {
+            const CBlockIndex* pindex = chain[nHeight];
+            if (!pindex->GeneratedStakeModifier())
+                continue;
+            vBlocks.push_back(pindex);
+            vMaxTime.push_back(vMaxTime.empty() ? pindex->GetBlockTime() : std::max(vMaxTime.back(), pindex->GetBlockTime()));
+        }
+        pindexSynced = chain.Tip();
+    }
+
+    // The first block above nHeightFrom that generated a modifier at or after nTime
+    const CBlockIndex* Find(int nHeightFrom, int64_t nTime) const
+    {
+        std::vector<const CBlockIndex*>::const_iterator itFrom = std::upper_bound(vBlocks.begin(), vBlocks.end(), nHeightFrom,
+            [](int nHeight, const CBlockIndex* pindex) { return nHeight < pindex->nHeight; });
+        size_t i = itFrom - vBlocks.begin();
+
+        // Nothing before the first position whose running maximum reaches nTime
+        // can qualify; a block before it in the range would have raised the maximum.
+        i = std::lower_bound(vMaxTime.begin() + i, vMaxTime.end(), nTime) - vMaxTime.begin();
+        for (; i < vBlocks.size(); i++) {
+            if (vBlocks[i]->GetBlockTime() >= nTime)
+                return vBlocks[i];
+        }
+        return NULL;
+    }
+};
+
+static CStakeModifierIndex stakeModifierIndex;
+
+void UpdateStakeModifierIndex()
+{
+    AssertLockHeld(cs_main);
+    stakeModifierIndex.Sync(chainActive);
+}
+
+// The stake modifier of an output is the one generated a selection interval
+// after the block the output is in
 bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
 {
     nStakeModifier = 0;
-    if (!mapBlockIndex.count(hashBlockFrom))
+    LOCK(cs_main);
+    BlockMap::const_iterator mi = mapBlockIndex.find(hashBlockFrom);
+    if (mi == mapBlockIndex.end())
         return error("GetKernelStakeModifier() : block not indexed");
-    const CBlockIndex* pindexFrom = mapBlockIndex[hashBlockFrom];
+    const CBlockIndex* pindexFrom = mi->second;
     nStakeModifierHeight = pindexFrom->nHeight;
     nStakeModifierTime = pindexFrom->GetBlockTime();
-    int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
-    const CBlockIndex* pindex = pindexFrom;
-    CBlockIndex* pindexNext = chainActive[pindexFrom->nHeight + 1];
-
-    // loop to find the stake modifier later by a selection interval
-    while (nStakeModifierTime < pindexFrom->GetBlockTime() + nStakeModifierSelectionInterval) {
-        if (!pindexNext) {
-            // Should never happen
-            return error("Null pindexNext\n");
-        }
 
-        pindex = pindexNext;
-        pindexNext = chainActive[pindexNext->nHeight + 1];
-        if (pindex->GeneratedStakeModifier()) {
-            nStakeModifierHeight = pindex->nHeight;
-            nStakeModifierTime = pindex->GetBlockTime();
-        }
+    static const int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
+    UpdateStakeModifierIndex();
+    const CBlockIndex* pindex = stakeModifierIndex.Find(pindexFrom->nHeight, pindexFrom->GetBlockTime() + nStakeModifierSelectionInterval);
+    if (!pindex) {
+        // The chain does not reach a selection interval past the block yet
+        return error("Null pindexNext\n");
     }
+
+    nStakeModifierHeight = pindex->nHeight;
+    nStakeModifierTime = pindex->GetBlockTime();
     nStakeModifier = pindex->nStakeModifier;
     return true;
 }
@@ -316,7 +379,7 @@ bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockF
     bool fSuccess = false;
     unsigned int nTryTime = 0;
     int nHeightStart = chainActive.Height();
-    int nHashDrift = 30;
+    int nHashDrift = STAKE_HASH_DRIFT;
     CDataStream ssUniqueID = stakeInput->GetUniqueness();
     CAmount nValueIn = stakeInput->GetValue();
     for (int i = 0; i < nHashDrift; i++) //iterate the hashing
@@ -343,6 +406,145 @@ bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockF
     return fSuccess;
 }
 
+bool SearchStakeKernels(const std::vector<CStakeKernelCandidate>& vCandidates, unsigned int nBits, unsigned int& nTimeTx, size_t& nIndexRet, uint256& hashProofOfStake, uint64_t* pnHashes)
+{
+    uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits);
+
+    // Best kernel so far; nBestTime is read without the lock to cut short inputs that cannot beat it
+    boost::mutex mutexBest;
+    std::atomic<unsigned int> nBestTime(0);
+    size_t nBestIndex = 0;
+    uint256 hashBest;
+    std::atomic<uint64_t> nHashes(0);
+
+    const unsigned int nTimeStart = nTimeTx;
+    auto search = [&](size_t nBegin, size_t nEnd) {
+        uint64_t nBatchHashes = 0;
+        for (size_t n = nBegin; n < nEnd; n++) {
+            const CStakeKernelCandidate& candidate = vCandidates[n];
+            for (int i = 0; i < STAKE_HASH_DRIFT; i++) {
+                unsigned int nTryTime = nTimeStart + STAKE_HASH_DRIFT - i;
+                if (nTryTime < nBestTime)
+                    break;
+
+                uint256 hashProof;
+                nBatchHashes++;
+                if (!CheckStake(candidate.ssUniqueID, candidate.nValue, candidate.nStakeModifier, bnTargetPerCoinDay, candidate.nTimeBlockFrom, nTryTime, hashProof))
+                    continue;
+
+                boost::unique_lock<boost::mutex> lock(mutexBest);
+                if (nTryTime > nBestTime || (nTryTime == nBestTime && n < nBestIndex)) {
+                    nBestTime = nTryTime;
+                    nBestIndex = n;
+                    hashBest = hashProof;
+                }
+                break;
+            }
+        }
+        nHashes += nBatchHashes;
+        return true;
+    };
+
+    {
+        CCheckQueueControl control(GetScriptCheckQueue());
+        for (size_t nBegin = 0; nBegin < vCandidates.size(); nBegin += STAKE_SEARCH_BATCH) {
+            size_t nEnd = std::min(nBegin + STAKE_SEARCH_BATCH, vCandidates.size());
+            control.Add([&search, nBegin, nEnd]() { return search(nBegin, nEnd); });
+        }
+        control.Wait();
+    }
+
+    if (pnHashes)
+        *pnHashes += nHashes;
+
+    if (nBestTime == 0)
+        return false;
+
+    nTimeTx = nBestTime;
+    nIndexRet = nBestIndex;
+    hashProofOfStake = hashBest;
+    return true;
+}
+
+// Staked outputs resolved by CheckProofOfStake, so that checking a block
+// again, or a competing block with the same kernel, reads nothing
+static const size_t STAKE_PREVOUT_CACHE_SIZE = 1000;
+
+struct CStakePrevout {
+    CTxOut out;
+    uint256 hashBlock;
+};
+
+class CStakePrevoutCache
+{
+private:
+    typedef std::list<std::pair<COutPoint, CStakePrevout> > LRUList;
+
+    CCriticalSection cs;
+    //! most recently used first
+    LRUList listPrevouts;
+    std::map<COutPoint, LRUList::iterator> mapPrevouts;
+
+public:
+    bool Get(const COutPoint& prevout, CStakePrevout& stakePrevout)
+    {
+        LOCK(cs);
+        std::map<COutPoint, LRUList::iterator>::iterator it = mapPrevouts.find(prevout);
+        if (it == mapPrevouts.end())
+            return false;
+        listPrevouts.splice(listPrevouts.begin(), listPrevouts, it->second);
+        stakePrevout = it->second->second;
+        return true;
+    }
+
+    void Insert(const COutPoint& prevout, const CStakePrevout& stakePrevout)
+    {
+        LOCK(cs);
+        if (mapPrevouts.count(prevout))
+            return;
+        listPrevouts.push_front(std::make_pair(prevout, stakePrevout));
+        mapPrevouts[prevout] = listPrevouts.begin();
+        if (listPrevouts.size() > STAKE_PREVOUT_CACHE_SIZE) {
+            mapPrevouts.erase(listPrevouts.back().first);
+            listPrevouts.pop_back();
+        }
+    }
+};
+
+static CStakePrevoutCache stakePrevoutCache;
+
+// Find the output a coinstake spends and the block it is in: from the cache,
+// then the UTXO set, and only for outputs already spent (a block on a fork)
+// from the transaction itself
+static bool GetStakePrevout(const COutPoint& prevout, CStakePrevout& stakePrevout)
+{
+    if (stakePrevoutCache.Get(prevout, stakePrevout))
+        return true;
+
+    {
+        LOCK(cs_main);
+        const CCoins* coins = pcoinsTip->AccessCoins(prevout.hash);
+        if (coins && coins->IsAvailable(prevout.n) && coins->nHeight <= chainActive.Height()) {
+            stakePrevout.out = coins->vout[prevout.n];
+            stakePrevout.hashBlock = chainActive[coins->nHeight]->GetBlockHash();
+            stakePrevoutCache.Insert(prevout, stakePrevout);
+            return true;
+        }
+    }
+
+    CTransaction txPrev;
+    uint256 hashBlock;
+    if (!GetTransaction(prevout.hash, txPrev, hashBlock, true) || prevout.n >= txPrev.vout.size())
+        return false;
+
+    stakePrevout.out = txPrev.vout[prevout.n];
+    stakePrevout.hashBlock = hashBlock;
+    if (hashBlock != 0)
+        stakePrevoutCache.Insert(prevout, stakePrevout);
+    return true;
+}
+
 // Check kernel hash target and coinstake signature
 bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::unique_ptr<CStakeInput>& stake)
 {
@@ -361,18 +563,25 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
 
         stake = std::unique_ptr<CStakeInput>(new CZAraStake(spend));
     } else {
-        // First try finding the previous transaction in database
-        uint256 hashBlock;
-        CTransaction txPrev;
-        if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
+        CStakePrevout stakePrevout;
+        if (!GetStakePrevout(txin.prevout, stakePrevout))
             return error("CheckProofOfStake() : INFO: read txPrev failed");
 
         //verify signature and script
-        if (!VerifyScript(txin.scriptSig, txPrev.vout[txin.prevout.n].scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
+        if (!VerifyScript(txin.scriptSig, stakePrevout.out.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
             return error("CheckProofOfStake() : VerifySignature failed on coinstake %s", tx.GetHash().ToString().c_str());
 
+        // The block must be on the active chain, as GetIndexFrom() requires for wallet stakes
+        CBlockIndex* pindexFrom = NULL;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(stakePrevout.hashBlock);
+            if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second))
+                pindexFrom = mi->second;
+        }
+
         CAraStake* araInput = new CAraStake();
-        araInput->SetInput(txPrev, txin.prevout.n);
+        araInput->SetPrevout(txin.prevout, stakePrevout.out, pindexFrom);
         stake = std::unique_ptr<CStakeInput>(araInput);
     }
 
@@ -380,11 +589,6 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
     if (!pindex)
         return error("%s: Failed to find the block index", __func__);
 
-    // Read block header
-    CBlock blockprev;
-    if (!ReadBlockFromDisk(blockprev, pindex->GetBlockPos()))
-        return error("CheckProofOfStake(): INFO: failed to find block");
-
     uint256 bnTargetPerCoinDay;
     bnTargetPerCoinDay.SetCompact(block.nBits);
 
@@ -392,7 +596,7 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
     if (!stake->GetModifier(nStakeModifier))
         return error("%s failed to get modifier for stake input\n", __func__);
 
-    unsigned int nBlockFromTime = blockprev.nTime;
+    unsigned int nBlockFromTime = pindex->nTime;
     unsigned int nTxTime = block.nTime;
     if (!CheckStake(stake->GetUniqueness(), stake->GetValue(), nStakeModifier, bnTargetPerCoinDay, nBlockFromTime,
                     nTxTime, hashProofOfStake)) {
@@ -411,14 +615,14 @@ bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx)
 }
 
 // Get stake modifier checksum
-unsigned int GetStakeModifierChecksum(const CBlockIndex* pindex)
+unsigned int GetStakeModifierChecksum(const CBlockIndex* pindex, const uint256& hashProofOfStake)
 {
     assert(pindex->pprev || pindex->GetBlockHash() == Params().HashGenesisBlock());
     // Hash previous checksum with flags, hashProofOfStake and nStakeModifier
     CDataStream ss(SER_GETHASH, 0);
     if (pindex->pprev)
         ss << pindex->pprev->nStakeModifierChecksum;
-    ss << pindex->nFlags << pindex->hashProofOfStake << pindex->nStakeModifier;
+    ss << pindex->nFlags << hashProofOfStake << pindex->nStakeModifier;
     uint256 hashChecksum = Hash(ss.begin(), ss.end());
     hashChecksum >>= (256 - 32);
     return hashChecksum.Get64();
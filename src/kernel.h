@@ -20,13 +20,38 @@ extern unsigned int getIntervalVersion(bool fTestNet);
 // ratio of group interval length between the last group and the first group
 static const int MODIFIER_INTERVAL_RATIO = 3;
 
+// Bring the index of modifier-generating blocks in line with chainActive
+void UpdateStakeModifierIndex();
+
 // Compute the hash modifier for proof-of-stake
 bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake);
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
+// Number of timestamps after nTimeTx that are hashed for every stake input
+static const int STAKE_HASH_DRIFT = 30;
+// Stake inputs handed to one job of the parallel kernel search
+static const unsigned int STAKE_SEARCH_BATCH = 64;
+
+// What the kernel hash of one stake input needs, gathered up front so that
+// searching it takes no locks
+struct CStakeKernelCandidate {
+    CDataStream ssUniqueID;
+    CAmount nValue;
+    uint64_t nStakeModifier;
+    unsigned int nTimeBlockFrom;
+
+    CStakeKernelCandidate(const CDataStream& ssUniqueIDIn, CAmount nValueIn, uint64_t nStakeModifierIn, unsigned int nTimeBlockFromIn)
+        : ssUniqueID(ssUniqueIDIn), nValue(nValueIn), nStakeModifier(nStakeModifierIn), nTimeBlockFrom(nTimeBlockFromIn) {}
+};
+
 bool CheckStake(const CDataStream& ssUniqueID, CAmount nValueIn, const uint64_t nStakeModifier, const uint256& bnTarget, unsigned int nTimeBlockFrom, unsigned int& nTimeTx, uint256& hashProofOfStake);
 bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTargetPerCoinDay);
 bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockFrom, unsigned int& nTimeTx, uint256& hashProofOfStake);
+// Hash the kernels of all candidates, split over the script check threads.
+// On success nIndexRet is the candidate with the latest kernel time (the
+// lowest index among equal times) and nTimeTx is set to that time. The
+// number of kernel hashes computed is added to *pnHashes if given.
+bool SearchStakeKernels(const std::vector<CStakeKernelCandidate>& vCandidates, unsigned int nBits, unsigned int& nTimeTx, size_t& nIndexRet, uint256& hashProofOfStake, uint64_t* pnHashes = NULL);
 
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
@@ -36,7 +61,7 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
 bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx);
 
 // Get stake modifier checksum
-unsigned int GetStakeModifierChecksum(const CBlockIndex* pindex);
+unsigned int GetStakeModifierChecksum(const CBlockIndex* pindex, const uint256& hashProofOfStake);
 
 // Check stake modifier hard checkpoints
 bool CheckStakeModifierCheckpoints(int nHeight, unsigned int nStakeModifierChecksum);
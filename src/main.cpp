@@ -12,12 +12,15 @@
 #include "accumulatormap.h"
 #include "addrman.h"
 #include "alert.h"
+#include "blockindexsnapshot.h"
 #include "blocksignature.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "crypto/common.h"
 #include "init.h"
 #include "kernel.h"
+#include "mappedfile.h"
 #include "masternode-budget.h"
 #include "masternode-payments.h"
 #include "masternodeman.h"
@@ -43,6 +46,7 @@
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/lexical_cast.hpp>
@@ -72,11 +76,13 @@ int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+static CCheckQueue scriptcheckqueue(MAX_SCRIPTCHECK_THREADS);
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
+uint256 hashAssumeValid;
 bool fVerifyingBlocks = false;
 unsigned int nCoinCacheSize = 5000;
 bool fAlerts = DEFAULT_ALERTS;
@@ -1033,9 +1039,9 @@ bool ContextualCheckZerocoinMint(const CTransaction& tx, const PublicCoin& coin,
 	return true;
 }
 
-bool ContextualCheckZerocoinSpend(const CTransaction& tx, const CoinSpend& spend, CBlockIndex* pindex, const uint256& hashBlock)
+bool ContextualCheckZerocoinSpend(const CTransaction& tx, const CoinSpend& spend, CBlockIndex* pindex, const uint256& hashBlock, bool fCheckSignature)
 {
-	if (!ContextualCheckZerocoinSpendNoSerialCheck(tx, spend, pindex, hashBlock)) {
+	if (!ContextualCheckZerocoinSpendNoSerialCheck(tx, spend, pindex, hashBlock, fCheckSignature)) {
 		return false;
 	}
 
@@ -1048,12 +1054,12 @@ bool ContextualCheckZerocoinSpend(const CTransaction& tx, const CoinSpend& spend
 	return true;
 }
 
-bool ContextualCheckZerocoinSpendNoSerialCheck(const CTransaction& tx, const CoinSpend& spend, CBlockIndex* pindex, const uint256& hashBlock)
+bool ContextualCheckZerocoinSpendNoSerialCheck(const CTransaction& tx, const CoinSpend& spend, CBlockIndex* pindex, const uint256& hashBlock, bool fCheckSignature)
 {
 
 	//Check to see if the zARA is properly signed
 	if (pindex->nHeight >= Params().Zerocoin_Block_V2_Start()) {
-		if (!spend.HasValidSignature())
+		if (fCheckSignature && !spend.HasValidSignature())
 			return error("%s: V2 zARA spend does not have a valid signature", __func__);
 
 		libzerocoin::SpendType expectedType = libzerocoin::SpendType::SPEND;
@@ -1307,7 +1313,21 @@ CAmount GetMinRelayFee(const CTransaction& tx, unsigned int nBytes, bool fAllowF
 }
 
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees)
+void LimitMempoolSize(CTxMemPool& pool, size_t limit, unsigned long age)
+{
+	int expired = pool.Expire(GetTime() - age);
+	if (expired != 0)
+		LogPrint("mempool", "Expired %i transactions from the memory pool\n", expired);
+
+	pool.TrimToSize(limit);
+}
+
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool ignoreFees, bool fOverrideMempoolLimit)
+{
+	return AcceptToMemoryPoolWithTime(pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), fRejectInsaneFee, ignoreFees, fOverrideMempoolLimit);
+}
+
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, int64_t nAcceptTime, bool fRejectInsaneFee, bool ignoreFees, bool fOverrideMempoolLimit)
 {
 	AssertLockHeld(cs_main);
 	if (pfMissingInputs)
@@ -1378,7 +1398,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
 			//Check that txid is not already in the chain
 			int nHeightTx = 0;
-			if (IsTransactionInChain(tx.GetHash(), nHeightTx))
+			if (IsSpendTxInBlockchain(tx.GetHash(), nHeightTx))
 				return state.Invalid(error("AcceptToMemoryPool : zARA spend tx %s already in block %d",
 					tx.GetHash().GetHex(), nHeightTx), REJECT_DUPLICATE, "bad-txns-inputs-spent");
 
@@ -1471,9 +1491,9 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 		CAmount nFees = nValueIn - nValueOut;
 		double dPriority = 0;
 		if (!tx.IsZerocoinSpend())
-			view.GetPriority(tx, chainActive.Height());
+			dPriority = view.GetPriority(tx, chainActive.Height());
 
-		CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainActive.Height());
+		CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainActive.Height());
 		unsigned int nSize = entry.GetTxSize();
 
 		// Don't accept it if it can't get into a block
@@ -1488,6 +1508,13 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 					hash.ToString(), nFees, txMinFee),
 					REJECT_INSUFFICIENTFEE, "insufficient fee");
 
+			// Once the pool has been full, the feerate has to beat what was evicted to get in
+			CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFee(nSize);
+			if (mempoolRejectFee > 0 && nFees < mempoolRejectFee && !tx.IsZerocoinSpend())
+				return state.DoS(0, error("AcceptToMemoryPool : mempool min fee not met %s, %d < %d",
+					hash.ToString(), nFees, mempoolRejectFee),
+					REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+
 			// Require that free transactions have sufficient priority to be mined in the next block.
 			if (tx.IsZerocoinMint()) {
 				if (nFees < Params().Zerocoin_MintFee() * tx.GetZerocoinMintCount())
@@ -1526,9 +1553,31 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 				hash.ToString(),
 				nFees, ::minRelayTxFee.GetFee(nSize) * 10000);
 
+		// Calculate in-mempool ancestors, up to a limit.
+		CTxMemPool::setEntries setAncestors;
+		size_t nLimitAncestors = GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT);
+		size_t nLimitAncestorSize = GetArg("-limitancestorsize", DEFAULT_ANCESTOR_SIZE_LIMIT) * 1000;
+		size_t nLimitDescendants = GetArg("-limitdescendantcount", DEFAULT_DESCENDANT_LIMIT);
+		size_t nLimitDescendantSize = GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000;
+		std::string errString;
+		if (!pool.CalculateMemPoolAncestors(entry, setAncestors, nLimitAncestors, nLimitAncestorSize, nLimitDescendants, nLimitDescendantSize, errString)) {
+			return state.DoS(0, error("AcceptToMemoryPool : too long mempool chain %s: %s", hash.ToString(), errString),
+				REJECT_NONSTANDARD, "too-long-mempool-chain");
+		}
+
 		// Check against previous transactions
 		// This is done last to help prevent CPU exhaustion denial-of-service attacks.
-		if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true)) {
+		// The scripts run on the check queue; if one fails they are run again here to find out
+		// which and why. Either way the signatures end up in the signature cache for the checks below.
+		std::vector<CScriptCheck> vChecks;
+		bool fInputsOk = CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true, nScriptCheckThreads ? &vChecks : NULL);
+		if (fInputsOk && !vChecks.empty()) {
+			CCheckQueueControl control(&scriptcheckqueue);
+			control.Add(vChecks);
+			if (!control.Wait())
+				fInputsOk = CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true);
+		}
+		if (!fInputsOk) {
 			return error("AcceptToMemoryPool: : ConnectInputs failed %s", hash.ToString());
 		}
 
@@ -1545,8 +1594,22 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 			return error("AcceptToMemoryPool: : BUG! PLEASE REPORT THIS! ConnectInputs failed against MANDATORY but not STANDARD flags %s", hash.ToString());
 		}
 
+		// Run the scripts once more with the flags blocks use. The signatures come from the
+		// signature cache by now, and the result is kept in the script execution cache so that
+		// connecting the block that includes this transaction does not run its scripts again.
+		if (!CheckInputs(tx, state, view, true, BLOCK_SCRIPT_VERIFY_FLAGS, true)) {
+			return error("AcceptToMemoryPool: : BUG! PLEASE REPORT THIS! ConnectInputs failed against block but not STANDARD flags %s", hash.ToString());
+		}
+
 		// Store transaction in memory
-		pool.addUnchecked(hash, entry);
+		pool.addUnchecked(hash, entry, setAncestors);
+
+		// Trim the mempool and check whether the tx was trimmed
+		if (!fOverrideMempoolLimit) {
+			LimitMempoolSize(pool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+			if (!pool.exists(hash))
+				return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
+		}
 	}
 
 	SyncWithWallets(tx, NULL);
@@ -1558,6 +1621,141 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 	return true;
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+static const unsigned int MEMPOOL_LOAD_BATCH = 500;
+
+bool DumpMempool()
+{
+	int64_t nStart = GetTimeMillis();
+
+	std::vector<std::pair<uint64_t, std::pair<CTransaction, int64_t> > > vEntries;
+	std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+	std::map<uint256, int64_t> mapSpendTimes;
+	{
+		LOCK2(cs_main, mempool.cs);
+		vEntries.reserve(mempool.mapTx.size());
+		for (CTxMemPool::indexed_transaction_set::const_iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end(); ++mi) {
+			vEntries.push_back(std::make_pair(mi->GetCountWithAncestors(), std::make_pair(mi->GetTx(), mi->GetTime())));
+			if (mi->GetTx().IsZerocoinSpend()) {
+				std::map<uint256, int64_t>::const_iterator it = mapZerocoinspends.find(mi->GetTx().GetHash());
+				if (it != mapZerocoinspends.end())
+					mapSpendTimes.insert(*it);
+			}
+		}
+		mapDeltas = mempool.mapDeltas;
+	}
+
+	// Fewer in-mempool ancestors first, so every parent is loaded before its children
+	std::stable_sort(vEntries.begin(), vEntries.end(),
+		[](const std::pair<uint64_t, std::pair<CTransaction, int64_t> >& a, const std::pair<uint64_t, std::pair<CTransaction, int64_t> >& b) {
+			return a.first < b.first;
+		});
+
+	boost::filesystem::path pathTmp = GetDataDir() / "mempool.dat.new";
+	try {
+		CAutoFile fileout(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+		if (fileout.IsNull())
+			return error("%s : failed to open %s", __func__, pathTmp.string());
+
+		fileout << MEMPOOL_DUMP_VERSION;
+		fileout << (uint64_t)vEntries.size();
+		for (const auto& entry : vEntries) {
+			fileout << entry.second.first;
+			fileout << entry.second.second;
+		}
+		fileout << mapDeltas;
+		fileout << mapSpendTimes;
+		FileCommit(fileout.Get());
+	} catch (const std::exception& e) {
+		return error("%s : failed to write mempool: %s", __func__, e.what());
+	}
+
+	if (!RenameOver(pathTmp, GetDataDir() / "mempool.dat"))
+		return error("%s : failed to rename %s", __func__, pathTmp.string());
+
+	LogPrintf("Dumped %u mempool transactions to disk in %dms\n", vEntries.size(), GetTimeMillis() - nStart);
+	return true;
+}
+
+bool LoadMempool()
+{
+	int64_t nStart = GetTimeMillis();
+	int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+
+	boost::filesystem::path path = GetDataDir() / "mempool.dat";
+	CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+	if (filein.IsNull()) {
+		LogPrintf("%s : no mempool file at %s\n", __func__, path.string());
+		return false;
+	}
+
+	std::vector<std::pair<CTransaction, int64_t> > vEntries;
+	std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+	std::map<uint256, int64_t> mapSpendTimes;
+	try {
+		uint64_t nVersion;
+		filein >> nVersion;
+		if (nVersion != MEMPOOL_DUMP_VERSION)
+			return error("%s : unknown mempool file version %d", __func__, nVersion);
+
+		uint64_t nEntries;
+		filein >> nEntries;
+		vEntries.reserve(std::min(nEntries, (uint64_t)100000));
+		while (nEntries--) {
+			CTransaction tx;
+			int64_t nTime;
+			filein >> tx;
+			filein >> nTime;
+			vEntries.push_back(std::make_pair(tx, nTime));
+		}
+		filein >> mapDeltas;
+		filein >> mapSpendTimes;
+	} catch (const std::exception& e) {
+		return error("%s : failed to read mempool file: %s", __func__, e.what());
+	}
+
+	// Deltas go in first, so that they count toward the fee checks on acceptance
+	for (const auto& delta : mapDeltas)
+		mempool.PrioritiseTransaction(delta.first, delta.first.ToString(), delta.second.first, delta.second.second);
+
+	// Re-accept in batches under one cs_main lock each, and trim the pool once at the end
+	int nAccepted = 0, nFailed = 0, nExpired = 0;
+	int64_t nNow = GetTime();
+	std::vector<std::pair<CTransaction, int64_t> >::const_iterator it = vEntries.begin();
+	while (it != vEntries.end()) {
+		if (ShutdownRequested())
+			return false;
+
+		LOCK(cs_main);
+		for (unsigned int i = 0; i < MEMPOOL_LOAD_BATCH && it != vEntries.end(); i++, ++it) {
+			const CTransaction& tx = it->first;
+			if (it->second + nExpiryTimeout <= nNow) {
+				nExpired++;
+				continue;
+			}
+
+			CValidationState state;
+			if (!AcceptToMemoryPoolWithTime(mempool, state, tx, false, NULL, it->second, false, false, true)) {
+				nFailed++;
+				continue;
+			}
+			nAccepted++;
+
+			std::map<uint256, int64_t>::const_iterator spendit = mapSpendTimes.find(tx.GetHash());
+			if (spendit != mapSpendTimes.end())
+				mapZerocoinspends[tx.GetHash()] = spendit->second;
+		}
+	}
+
+	{
+		LOCK(cs_main);
+		LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, nExpiryTimeout);
+	}
+
+	LogPrintf("Loaded mempool from disk in %dms: %d accepted, %d failed, %d expired\n", GetTimeMillis() - nStart, nAccepted, nFailed, nExpired);
+	return true;
+}
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool isDSTX)
 {
 	AssertLockHeld(cs_main);
@@ -1758,6 +1956,35 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 	return true;
 }
 
+/**
+ * Map the block or undo file holding the record stored at pos by WriteBlockToDisk or
+ * CBlockUndo::WriteToDisk, and return the record length from its index header. The
+ * nTrailer bytes following the record (the undo checksum) are mapped as well.
+ * Only files that are no longer appended to are mapped; NULL means read with stdio.
+ */
+static CMappedFileRef MapDiskRecord(const CDiskBlockPos& pos, const char* prefix, unsigned int nTrailer, unsigned int& nSize)
+{
+	{
+		LOCK(cs_LastBlockFile);
+		if (pos.nFile >= nLastBlockFile)
+			return CMappedFileRef();
+	}
+	if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+		return CMappedFileRef();
+
+	boost::filesystem::path path = GetBlockPosFilename(pos, prefix);
+	CMappedFileRef pfile = mappedBlockFiles.Get(path, pos.nPos);
+	if (!pfile)
+		return pfile;
+	const char* pheader = pfile->begin() + pos.nPos - MESSAGE_START_SIZE - sizeof(unsigned int);
+	if (memcmp(pheader, Params().MessageStart(), MESSAGE_START_SIZE))
+		return CMappedFileRef();
+	nSize = ReadLE32((const unsigned char*)pheader + MESSAGE_START_SIZE);
+
+	// Undo data can still be appended to an older rev file, remap if the record lies past the mapped end
+	return mappedBlockFiles.Get(path, (size_t)pos.nPos + nSize + nTrailer);
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock, bool fAllowSlow)
 {
@@ -1773,17 +2000,32 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
 		if (fTxIndex) {
 			CDiskTxPos postx;
 			if (pblocktree->ReadTxIndex(hash, postx)) {
-				CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-				if (file.IsNull())
-					return error("%s: OpenBlockFile failed", __func__);
 				CBlockHeader header;
-				try {
-					file >> header;
-					fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-					file >> txOut;
+				unsigned int nSize;
+				CMappedFileRef pfile = MapDiskRecord(postx, "blk", 0, nSize);
+				if (pfile) {
+					try {
+						CMemoryReader reader(pfile->begin() + postx.nPos, pfile->begin() + postx.nPos + nSize, SER_DISK, CLIENT_VERSION);
+						reader >> header;
+						reader.ignore(postx.nTxOffset);
+						reader >> txOut;
+					}
+					catch (std::exception& e) {
+						return error("%s : Deserialize error - %s", __func__, e.what());
+					}
 				}
-				catch (std::exception& e) {
-					return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+				else {
+					CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+					if (file.IsNull())
+						return error("%s: OpenBlockFile failed", __func__);
+					try {
+						file >> header;
+						fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+						file >> txOut;
+					}
+					catch (std::exception& e) {
+						return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+					}
 				}
 				hashBlock = header.GetHash();
 				if (txOut.GetHash() != hash)
@@ -1809,9 +2051,9 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
 	}
 
 	if (pindexSlow) {
-		CBlock block;
-		if (ReadBlockFromDisk(block, pindexSlow)) {
-			BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+		CBlockRef pblock;
+		if (ReadBlockFromDisk(pblock, pindexSlow)) {
+			BOOST_FOREACH(const CTransaction& tx, pblock->vtx) {
 				if (tx.GetHash() == hash) {
 					txOut = tx;
 					hashBlock = pindexSlow->GetBlockHash();
@@ -1855,17 +2097,31 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
 {
 	block.SetNull();
 
-	// Open history file to read
-	CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-	if (filein.IsNull())
-		return error("ReadBlockFromDisk : OpenBlockFile failed");
-
-	// Read block
-	try {
-		filein >> block;
+	unsigned int nSize;
+	CMappedFileRef pfile = MapDiskRecord(pos, "blk", 0, nSize);
+	if (pfile) {
+		// Deserialize straight from the mapped file
+		try {
+			CMemoryReader reader(pfile->begin() + pos.nPos, pfile->begin() + pos.nPos + nSize, SER_DISK, CLIENT_VERSION);
+			reader >> block;
+		}
+		catch (std::exception& e) {
+			return error("%s : Deserialize error - %s", __func__, e.what());
+		}
 	}
-	catch (std::exception& e) {
-		return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+	else {
+		// Open history file to read
+		CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+		if (filein.IsNull())
+			return error("ReadBlockFromDisk : OpenBlockFile failed");
+
+		// Read block
+		try {
+			filein >> block;
+		}
+		catch (std::exception& e) {
+			return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+		}
 	}
 
 	// Check the header
@@ -1877,14 +2133,83 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
 	return true;
 }
 
+bool ReadRawBlockFromDisk(CDataStream& ssBlock, const CDiskBlockPos& pos, const uint256& hash)
+{
+	ssBlock.clear();
+	if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+		return error("ReadRawBlockFromDisk : invalid block position %d:%u", pos.nFile, pos.nPos);
+
+	unsigned int nSize;
+	CMappedFileRef pfile = MapDiskRecord(pos, "blk", 0, nSize);
+	if (pfile) {
+		if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+			return error("%s : invalid block size %u at %d:%u", __func__, nSize, pos.nFile, pos.nPos);
+		ssBlock.write(pfile->begin() + pos.nPos, nSize);
+	}
+	else {
+		// Open history file at the index header written by WriteBlockToDisk
+		CDiskBlockPos posHeader(pos.nFile, pos.nPos - MESSAGE_START_SIZE - sizeof(unsigned int));
+		CAutoFile filein(OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+		if (filein.IsNull())
+			return error("ReadRawBlockFromDisk : OpenBlockFile failed");
+
+		try {
+			unsigned char pchMessageStart[MESSAGE_START_SIZE];
+			filein >> FLATDATA(pchMessageStart) >> nSize;
+			if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE))
+				return error("%s : block magic mismatch at %d:%u", __func__, pos.nFile, pos.nPos);
+			if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+				return error("%s : invalid block size %u at %d:%u", __func__, nSize, pos.nFile, pos.nPos);
+			ssBlock.resize(nSize);
+			filein.read(&ssBlock[0], nSize);
+		}
+		catch (std::exception& e) {
+			return error("%s : I/O error - %s", __func__, e.what());
+		}
+	}
+
+	// Only the header is parsed, to make sure the position still belongs to the requested block
+	CBlockHeader header;
+	size_t nHeaderSize = std::min(ssBlock.size(), (size_t)::GetSerializeSize(header, SER_NETWORK, PROTOCOL_VERSION));
+	CDataStream ssHeader(ssBlock.begin(), ssBlock.begin() + nHeaderSize, SER_NETWORK, PROTOCOL_VERSION);
+	try {
+		ssHeader >> header;
+	}
+	catch (std::exception& e) {
+		return error("%s : Deserialize error - %s", __func__, e.what());
+	}
+	if (header.GetHash() != hash)
+		return error("ReadRawBlockFromDisk : block=%s doesn't match requested %s", header.GetHash().ToString(), hash.ToString());
+
+	return true;
+}
+
+bool ReadBlockFromDisk(CBlockRef& pblock, const CBlockIndex* pindex)
+{
+	pblock = blockCache.Get(pindex->GetBlockHash());
+	if (pblock)
+		return true;
+
+	std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+	if (!ReadBlockFromDisk(*pblockNew, pindex->GetBlockPos()))
+		return false;
+	if (pblockNew->GetHash() != pindex->GetBlockHash()) {
+		LogPrintf("%s : block=%s index=%s\n", __func__, pblockNew->GetHash().ToString().c_str(), pindex->GetBlockHash().ToString().c_str());
+		return error("ReadBlockFromDisk(CBlockRef&, CBlockIndex*) : GetHash() doesn't match index");
+	}
+	pblock = pblockNew;
+	blockCache.Insert(pblock);
+	return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
 {
-	if (!ReadBlockFromDisk(block, pindex->GetBlockPos()))
+	CBlockRef pblock;
+	if (!ReadBlockFromDisk(pblock, pindex)) {
+		block.SetNull();
 		return false;
-	if (block.GetHash() != pindex->GetBlockHash()) {
-		LogPrintf("%s : block=%s index=%s\n", __func__, block.GetHash().ToString().c_str(), pindex->GetBlockHash().ToString().c_str());
-		return error("ReadBlockFromDisk(CBlock&, CBlockIndex*) : GetHash() doesn't match index");
 	}
+	block = *pblock;
 	return true;
 }
 
@@ -2195,6 +2520,60 @@ CAmount GetInvalidUTXOValue()
 	return nValue;
 }
 
+namespace {
+/**
+ * Transactions whose input scripts all passed with a given set of flags, so
+ * that the scripts of a transaction accepted to the memory pool are not run
+ * again when the block containing it is connected. The txid commits to the
+ * outputs being spent, and with them to the scripts and amounts checked.
+ */
+class CScriptExecutionCache
+{
+private:
+	//! Entries are salted hashes of (txid, flags), so they cannot be targeted
+	std::set<uint256> setValid;
+	boost::shared_mutex cs_scriptcache;
+	const uint256 nonce;
+
+	uint256 GetEntry(const CTransaction& tx, unsigned int flags) const
+	{
+		CHashWriter ss(SER_GETHASH, 0);
+		ss << nonce << tx.GetHash() << flags;
+		return ss.GetHash();
+	}
+
+public:
+	CScriptExecutionCache() : nonce(GetRandHash()) {}
+
+	bool Get(const CTransaction& tx, unsigned int flags)
+	{
+		uint256 entry = GetEntry(tx, flags);
+		boost::shared_lock<boost::shared_mutex> lock(cs_scriptcache);
+		return setValid.count(entry) != 0;
+	}
+
+	void Set(const CTransaction& tx, unsigned int flags)
+	{
+		int64_t nMaxCacheSize = GetArg("-maxscriptcachesize", DEFAULT_MAX_SCRIPT_CACHE_SIZE);
+		if (nMaxCacheSize <= 0)
+			return;
+
+		uint256 entry = GetEntry(tx, flags);
+		boost::unique_lock<boost::shared_mutex> lock(cs_scriptcache);
+		while (static_cast<int64_t>(setValid.size()) >= nMaxCacheSize) {
+			// Evict a random entry, like the signature cache
+			std::set<uint256>::iterator it = setValid.lower_bound(GetRandHash());
+			if (it == setValid.end())
+				it = setValid.begin();
+			setValid.erase(it);
+		}
+		setValid.insert(entry);
+	}
+};
+
+CScriptExecutionCache scriptExecutionCache;
+} // anon namespace
+
 bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsViewCache& inputs, bool fScriptChecks, unsigned int flags, bool cacheStore, std::vector<CScriptCheck>* pvChecks)
 {
 	if (!tx.IsCoinBase() && !tx.IsZerocoinSpend()) {
@@ -2256,6 +2635,10 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
 		// before the last block chain checkpoint. This is safe because block merkle hashes are
 		// still computed and checked, and any change will be caught at the next checkpoint.
 		if (fScriptChecks) {
+			// Every script of this transaction already passed with these flags
+			if (scriptExecutionCache.Get(tx, flags))
+				return true;
+
 			for (unsigned int i = 0; i < tx.vin.size(); i++) {
 				const COutPoint& prevout = tx.vin[i].prevout;
 				const CCoins* coins = inputs.AccessCoins(prevout.hash);
@@ -2290,6 +2673,10 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
 					return state.DoS(100, false, REJECT_INVALID, strprintf("mandatory-script-verify-flag-failed (%s)", ScriptErrorString(check.GetScriptError())));
 				}
 			}
+
+			// Only complete checks are cached, deferred ones have not run yet
+			if (cacheStore && !pvChecks)
+				scriptExecutionCache.Set(tx, flags);
 		}
 	}
 
@@ -2327,6 +2714,10 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
 		* */
 		if (tx.ContainsZerocoins()) {
 			if (tx.IsZerocoinSpend()) {
+				//verifying blocks on init disconnects them without changing the chain, keep them indexed
+				if (!fVerifyingBlocks && !zerocoinDB->EraseSpendTx(tx.GetHash()))
+					return error("failed to erase zerocoin spend transaction in block");
+
 				//erase all zerocoinspends in this transaction
 				for (const CTxIn& txin : tx.vin) {
 					if (txin.scriptSig.IsZerocoinSpend()) {
@@ -2401,6 +2792,7 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
 						fClean = fClean && error("DisconnectBlock() : undo data overwriting existing transaction");
 					coins->Clear();
 					coins->fCoinBase = undo.fCoinBase;
+					coins->fCoinStake = undo.fCoinStake;
 					coins->nHeight = undo.nHeight;
 					coins->nVersion = undo.nVersion;
 				}
@@ -2463,14 +2855,17 @@ void static FlushBlockFile(bool fFinalize = false)
 
 bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigned int nAddSize);
 
-static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
-
 void ThreadScriptCheck()
 {
 	RenameThread("aratriton-scriptch");
 	scriptcheckqueue.Thread();
 }
 
+CCheckQueue* GetScriptCheckQueue()
+{
+	return nScriptCheckThreads ? &scriptcheckqueue : NULL;
+}
+
 void RecalculateZARAMinted()
 {
 	CBlockIndex *pindex = chainActive[Params().Zerocoin_StartHeight()];
@@ -2486,10 +2881,9 @@ void RecalculateZARAMinted()
 		std::list<CZerocoinMint> listMints;
 		BlockToZerocoinMintList(block, listMints, true);
 
-		vector<libzerocoin::CoinDenomination> vDenomsBefore = pindex->vMintDenominationsInBlock;
-		pindex->vMintDenominationsInBlock.clear();
+		pindex->ClearMints();
 		for (auto mint : listMints)
-			pindex->vMintDenominationsInBlock.emplace_back(mint.GetDenomination());
+			pindex->AddMint(mint.GetDenomination());
 
 		if (pindex->nHeight < nHeightEnd)
 			pindex = chainActive.Next(pindex);
@@ -2512,17 +2906,17 @@ void RecalculateZARASpent()
 		list<libzerocoin::CoinDenomination> listDenomsSpent = ZerocoinSpendListFromBlock(block, true);
 
 		//Reset the supply to previous block
-		pindex->mapZerocoinSupply = pindex->pprev->mapZerocoinSupply;
+		pindex->SetZerocoinSupply(pindex->pprev);
 
 		//Add mints to zARA supply
 		for (auto denom : libzerocoin::zerocoinDenomList) {
-			long nDenomAdded = count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), denom);
-			pindex->mapZerocoinSupply.at(denom) += nDenomAdded;
+			long nDenomAdded = pindex->GetMintCount(denom);
+			pindex->SetZerocoinSupply(denom, pindex->GetZerocoinSupply(denom) + nDenomAdded);
 		}
 
 		//Remove spends from zARA supply
 		for (auto denom : listDenomsSpent)
-			pindex->mapZerocoinSupply.at(denom)--;
+			pindex->SetZerocoinSupply(denom, pindex->GetZerocoinSupply(denom) - 1);
 
 		//Rewrite money supply
 		assert(pblocktree->WriteBlockIndex(CDiskBlockIndex(pindex)));
@@ -2663,20 +3057,18 @@ bool UpdateZARASupply(const CBlock& block, CBlockIndex* pindex)
 
 	// Initialize zerocoin supply to the supply from previous block
 	if (pindex->pprev && pindex->pprev->GetBlockHeader().nVersion > 3) {
-		for (auto& denom : zerocoinDenomList) {
-			pindex->mapZerocoinSupply.at(denom) = pindex->pprev->mapZerocoinSupply.at(denom);
-		}
+		pindex->SetZerocoinSupply(pindex->pprev);
 	}
 
 	// Track zerocoin money supply
 	CAmount nAmountZerocoinSpent = 0;
-	pindex->vMintDenominationsInBlock.clear();
+	pindex->ClearMints();
 	if (pindex->pprev) {
 		std::set<uint256> setAddedToWallet;
 		for (auto& m : listMints) {
 			libzerocoin::CoinDenomination denom = m.GetDenomination();
-			pindex->vMintDenominationsInBlock.push_back(m.GetDenomination());
-			pindex->mapZerocoinSupply.at(denom)++;
+			pindex->AddMint(denom);
+			pindex->SetZerocoinSupply(denom, pindex->GetZerocoinSupply(denom) + 1);
 
 			//Remove any of our own mints from the mintpool
 			if (pwalletMain) {
@@ -2701,17 +3093,17 @@ bool UpdateZARASupply(const CBlock& block, CBlockIndex* pindex)
 		}
 
 		for (auto& denom : listSpends) {
-			pindex->mapZerocoinSupply.at(denom)--;
+			pindex->SetZerocoinSupply(denom, pindex->GetZerocoinSupply(denom) - 1);
 			nAmountZerocoinSpent += libzerocoin::ZerocoinDenominationToAmount(denom);
 
 			// zerocoin failsafe
-			if (pindex->mapZerocoinSupply.at(denom) < 0)
+			if (pindex->GetZerocoinSupply(denom) < 0)
 				return error("Block contains zerocoins that spend more than are in the available supply to spend");
 		}
 	}
 
 	for (auto& denom : zerocoinDenomList)
-		LogPrint("zero", "%s coins for denomination %d pubcoin %s\n", __func__, denom, pindex->mapZerocoinSupply.at(denom));
+		LogPrint("zero", "%s coins for denomination %d pubcoin %s\n", __func__, denom, pindex->GetZerocoinSupply(denom));
 
 	return true;
 }
@@ -2750,7 +3142,16 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 		return state.DoS(100, error("ConnectBlock() : PoW period ended"),
 			REJECT_INVALID, "PoW-ended");
 
-	bool fScriptChecks = pindex->nHeight >= Checkpoints::GetTotalBlocksEstimate();
+	// Script and zerocoin spend signatures are not verified for ancestors of the -assumevalid block, as long
+	// as it is on the best header chain and that chain is two weeks of blocks past the one being connected.
+	bool fScriptChecks = true;
+	if (hashAssumeValid != 0) {
+		BlockMap::const_iterator it = mapBlockIndex.find(hashAssumeValid);
+		if (it != mapBlockIndex.end() && it->second->GetAncestor(pindex->nHeight) == pindex &&
+			pindexBestHeader != NULL && pindexBestHeader->GetAncestor(pindex->nHeight) == pindex &&
+			pindexBestHeader->GetBlockTime() - pindex->GetBlockTime() > 60 * 60 * 24 * 7 * 2)
+			fScriptChecks = false;
+	}
 
 	// Do not allow blocks that contain transactions which 'overwrite' older transactions,
 	// unless those are already completely spent.
@@ -2776,7 +3177,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 		}
 	}
 
-	CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
+	CCheckQueueControl control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
 	int64_t nTimeStart = GetTimeMicros();
 	CAmount nFees = 0;
@@ -2811,7 +3212,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 			int nHeightTx = 0;
 			uint256 txid = tx.GetHash();
 			vSpendsInBlock.emplace_back(txid);
-			if (IsTransactionInChain(txid, nHeightTx)) {
+			if (IsSpendTxInBlockchain(txid, nHeightTx)) {
 				//when verifying blocks on init, the blocks are scanned without being disconnected - prevent that from causing an error
 				if (!fVerifyingBlocks || (fVerifyingBlocks && pindex->nHeight > nHeightTx))
 					return state.DoS(100, error("%s : txid %s already exists in block %d , trying to include it again in block %d", __func__,
@@ -2829,8 +3230,11 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
 				//queue for db write after the 'justcheck' section has concluded
 				vSpends.emplace_back(make_pair(spend, tx.GetHash()));
-				if (!ContextualCheckZerocoinSpend(tx, spend, pindex, hashBlock))
+				// The spend signature is verified on the check queue along with the scripts
+				if (!ContextualCheckZerocoinSpend(tx, spend, pindex, hashBlock, false))
 					return state.DoS(100, error("%s: failed to add block %s with invalid zerocoinspend", __func__, tx.GetHash().GetHex()), REJECT_INVALID);
+				if (fScriptChecks && pindex->nHeight >= Params().Zerocoin_Block_V2_Start())
+					control.Add([spend]() { return spend.HasValidSignature(); });
 			}
 
 			// Check that zARA mints are not already known
@@ -2892,8 +3296,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 			nValueIn += view.GetValueIn(tx);
 
 			std::vector<CScriptCheck> vChecks;
-			unsigned int flags = SCRIPT_VERIFY_P2SH | SCRIPT_VERIFY_DERSIG;
-			if (!CheckInputs(tx, state, view, fScriptChecks, flags, false, nScriptCheckThreads ? &vChecks : NULL))
+			if (!CheckInputs(tx, state, view, fScriptChecks, BLOCK_SCRIPT_VERIFY_FLAGS, false, nScriptCheckThreads ? &vChecks : NULL))
 				return false;
 			control.Add(vChecks);
 		}
@@ -3009,6 +3412,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
 	// Flush spend/mint info to disk
 	if (!zerocoinDB->WriteCoinSpendBatch(vSpends)) return state.Abort(("Failed to record coin serials to database"));
+	vector<pair<uint256, uint256> > vSpendTx;
+	for (const uint256& txid : vSpendsInBlock)
+		vSpendTx.emplace_back(txid, hashBlock);
+	if (!zerocoinDB->WriteSpendTxBatch(vSpendTx)) return state.Abort(("Failed to record zerocoin spend transactions to database"));
 	if (!zerocoinDB->WriteCoinMintBatch(vMints)) return state.Abort(("Failed to record new mints to database"));
 
 	//Record accumulator checksums
@@ -3096,6 +3503,8 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
 			}
 			pblocktree->Sync();
 			// Finally flush the chainstate (which may refer to block index entries).
+			// With -asyncflush this only hands the entries to the background writer;
+			// the block index above is already synced, so it is never behind the chainstate.
 			if (!pcoinsTip->Flush())
 				return state.Abort("Failed to write to coin database");
 			// Update best block in wallet (so we can detect restored wallets).
@@ -3121,7 +3530,7 @@ void FlushStateToDisk()
 void static UpdateTip(CBlockIndex* pindexNew)
 {
 	chainActive.SetTip(pindexNew);
-
+	UpdateStakeModifierIndex();
 
 	// New best block
 	nTimeBestReceived = GetTime();
@@ -3178,13 +3587,22 @@ bool static DisconnectTip(CValidationState& state)
 	if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
 		return false;
 	// Resurrect mempool transactions from the disconnected block.
+	std::vector<uint256> vHashUpdate;
 	BOOST_FOREACH(const CTransaction& tx, block.vtx) {
 		// ignore validation errors in resurrected transactions
 		list<CTransaction> removed;
 		CValidationState stateDummy;
-		if (tx.IsCoinBase() || tx.IsCoinStake() || !AcceptToMemoryPool(mempool, stateDummy, tx, false, NULL))
+		if (tx.IsCoinBase() || tx.IsCoinStake() || !AcceptToMemoryPool(mempool, stateDummy, tx, false, NULL, false, false, true))
 			mempool.remove(tx, removed, true);
-	}
+		else if (mempool.exists(tx.GetHash()))
+			vHashUpdate.push_back(tx.GetHash());
+	}
+	// AcceptToMemoryPool/addUnchecked all assume that new mempool entries have
+	// no in-mempool children, which is generally not true when adding
+	// previously-confirmed transactions back to the mempool.
+	// UpdateTransactionsFromBlock finds descendants of any transactions in this
+	// block that were added back and cleans up the mempool state.
+	mempool.UpdateTransactionsFromBlock(vHashUpdate);
 	mempool.removeCoinbaseSpends(pcoinsTip, pindexDelete->nHeight);
 	mempool.check(pcoinsTip);
 	// Update chainActive and related variables.
@@ -3264,6 +3682,9 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
 	mempool.check(pcoinsTip);
 	// Update chainActive & related variables.
 	UpdateTip(pindexNew);
+	// A freshly connected block is the one peers are about to request, keep it in memory
+	if (pblock != &block)
+		blockCache.Insert(std::make_shared<const CBlock>(*pblock));
 	// Tell wallet about transactions that went from mempool
 	// to conflicted:
 	BOOST_FOREACH(const CTransaction& tx, txConflicted) {
@@ -3453,9 +3874,11 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
 	const CBlockIndex* pindexFork = chainActive.FindFork(pindexMostWork);
 
 	// Disconnect active blocks which are no longer in the best chain.
+	bool fBlocksDisconnected = false;
 	while (chainActive.Tip() && chainActive.Tip() != pindexFork) {
 		if (!DisconnectTip(state))
 			return false;
+		fBlocksDisconnected = true;
 	}
 
 	// Build list of new blocks to connect.
@@ -3503,6 +3926,9 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
 		}
 	}
 
+	if (fBlocksDisconnected)
+		LimitMempoolSize(mempool, GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000, GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60);
+
 	// Callbacks/notifications for a new best chain.
 	if (fInvalidFound)
 		CheckForkWarningConditionsOnNewFork(vpindexToConnect.back());
@@ -3682,18 +4108,16 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
 		//update previous block pointer
 		pindexNew->pprev->pnext = pindexNew;
 
-		// ppcoin: compute chain trust score
-		pindexNew->bnChainTrust = (pindexNew->pprev ? pindexNew->pprev->bnChainTrust : 0) + pindexNew->GetBlockTrust();
-
 		// ppcoin: compute stake entropy bit for stake modifier
 		if (!pindexNew->SetStakeEntropyBit(pindexNew->GetStakeEntropyBit()))
 			LogPrintf("AddToBlockIndex() : SetStakeEntropyBit() failed \n");
 
-		// ppcoin: record proof-of-stake hash value
+		// ppcoin: proof-of-stake hash value, only needed for the stake modifier checksum below
+		uint256 hashProofOfStake = 0;
 		if (pindexNew->IsProofOfStake()) {
 			if (!mapProofOfStake.count(hash))
 				LogPrintf("AddToBlockIndex() : hashProofOfStake not found in map \n");
-			pindexNew->hashProofOfStake = mapProofOfStake[hash];
+			hashProofOfStake = mapProofOfStake[hash];
 		}
 
 		// ppcoin: compute stake modifier
@@ -3702,7 +4126,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
 		if (!ComputeNextStakeModifier(pindexNew->pprev, nStakeModifier, fGeneratedStakeModifier))
 			LogPrintf("AddToBlockIndex() : ComputeNextStakeModifier() failed \n");
 		pindexNew->SetStakeModifier(nStakeModifier, fGeneratedStakeModifier);
-		pindexNew->nStakeModifierChecksum = GetStakeModifierChecksum(pindexNew);
+		pindexNew->nStakeModifierChecksum = GetStakeModifierChecksum(pindexNew, hashProofOfStake);
 		if (!CheckStakeModifierCheckpoints(pindexNew->nHeight, pindexNew->nStakeModifierChecksum))
 			LogPrintf("AddToBlockIndex() : Rejected by stake modifier checkpoint height=%d, modifier=%s \n", pindexNew->nHeight, boost::lexical_cast<std::string>(nStakeModifier));
 	}
@@ -3870,6 +4294,23 @@ bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool f
 	return true;
 }
 
+static bool CheckBlockMerkleRoot(const CBlock& block, CValidationState& state)
+{
+	bool mutated;
+	uint256 hashMerkleRoot2 = block.BuildMerkleTree(&mutated);
+	if (block.hashMerkleRoot != hashMerkleRoot2)
+		return state.DoS(100, error("CheckBlock() : hashMerkleRoot mismatch"),
+			REJECT_INVALID, "bad-txnmrklroot", true);
+
+	// Check for merkle tree malleability (CVE-2012-2459): repeating sequences
+	// of transactions in a block without affecting the merkle root of a block,
+	// while still invalidating it.
+	if (mutated)
+		return state.DoS(100, error("CheckBlock() : duplicate transaction"),
+			REJECT_INVALID, "bad-txns-duplicate", true);
+	return true;
+}
+
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bool fCheckMerkleRoot, bool fCheckSig)
 {
 	// These are checks that are independent of context.
@@ -3887,20 +4328,8 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
 			REJECT_INVALID, "time-too-new");
 
 	// Check the merkle root.
-	if (fCheckMerkleRoot) {
-		bool mutated;
-		uint256 hashMerkleRoot2 = block.BuildMerkleTree(&mutated);
-		if (block.hashMerkleRoot != hashMerkleRoot2)
-			return state.DoS(100, error("CheckBlock() : hashMerkleRoot mismatch"),
-				REJECT_INVALID, "bad-txnmrklroot", true);
-
-		// Check for merkle tree malleability (CVE-2012-2459): repeating sequences
-		// of transactions in a block without affecting the merkle root of a block,
-		// while still invalidating it.
-		if (mutated)
-			return state.DoS(100, error("CheckBlock() : duplicate transaction"),
-				REJECT_INVALID, "bad-txns-duplicate", true);
-	}
+	if (fCheckMerkleRoot && !CheckBlockMerkleRoot(block, state))
+		return false;
 
 	// All potential-corruption validation must be done before we do any
 	// transaction validation, as otherwise we may mark the header as invalid
@@ -4788,22 +5217,31 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB(string& strError)
 {
-	if (!pblocktree->LoadBlockIndexGuts())
-		return false;
+	// The snapshot already carries nChainWork and the skip pointers, in height order
+	vector<pair<int, CBlockIndex*> > vSortedByHeight;
+	bool fFromSnapshot = GetBoolArg("-blockindexsnapshot", DEFAULT_BLOCK_INDEX_SNAPSHOT) && LoadBlockIndexSnapshot(vSortedByHeight);
+	if (!fFromSnapshot) {
+		// Make sure a snapshot left behind is never trusted after the database changes
+		pblocktree->EraseIndexSnapshotId();
+		if (!pblocktree->LoadBlockIndexGuts())
+			return false;
+	}
 
 	boost::this_thread::interruption_point();
 
 	// Calculate nChainWork
-	vector<pair<int, CBlockIndex*> > vSortedByHeight;
-	vSortedByHeight.reserve(mapBlockIndex.size());
-	for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
-		CBlockIndex* pindex = item.second;
-		vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
+	if (!fFromSnapshot) {
+		vSortedByHeight.reserve(mapBlockIndex.size());
+		for (const std::pair<const uint256, CBlockIndex*>& item : mapBlockIndex) {
+			CBlockIndex* pindex = item.second;
+			vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
+		}
+		sort(vSortedByHeight.begin(), vSortedByHeight.end());
 	}
-	sort(vSortedByHeight.begin(), vSortedByHeight.end());
 	BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*) & item, vSortedByHeight) {
 		CBlockIndex* pindex = item.second;
-		pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
+		if (!fFromSnapshot)
+			pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
 		if (pindex->nStatus & BLOCK_HAVE_DATA) {
 			if (pindex->pprev) {
 				if (pindex->pprev->nChainTx) {
@@ -4822,7 +5260,7 @@ bool static LoadBlockIndexDB(string& strError)
 			setBlockIndexCandidates.insert(pindex);
 		if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
 			pindexBestInvalid = pindex;
-		if (pindex->pprev)
+		if (pindex->pprev && !fFromSnapshot)
 			pindex->BuildSkip();
 		if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
 			pindexBestHeader = pindex;
@@ -4895,6 +5333,123 @@ bool static LoadBlockIndexDB(string& strError)
 	return true;
 }
 
+namespace {
+/** Number of blocks CVerifyDB reads ahead of the block it is verifying */
+const size_t VERIFYDB_READ_AHEAD = 32;
+
+/**
+ * Reads the blocks CVerifyDB walks through on worker threads, staying at most
+ * VERIFYDB_READ_AHEAD blocks ahead of the verifying thread. Only checks that
+ * need no chain context run here: the read itself, the merkle root (level 1)
+ * and the undo data (level 2). Everything else stays with the caller, which
+ * holds cs_main.
+ */
+class CVerifyDBReader
+{
+private:
+	struct CSlot {
+		CBlock block;
+		std::string strError;
+		bool fDone;
+		CSlot() : fDone(false) {}
+	};
+
+	const std::vector<CBlockIndex*>& vIndex;
+	const int nCheckLevel;
+	std::vector<CSlot> vSlots;
+	boost::mutex mutex;
+	boost::condition_variable cond;
+	size_t nNextRead;
+	size_t nNextGet;
+	bool fStop;
+	boost::thread_group threadGroup;
+
+	bool ReadAndCheck(const CBlockIndex* pindex, CBlock& block, std::string& strError) const
+	{
+		if (!ReadBlockFromDisk(block, pindex)) {
+			strError = strprintf("ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+			return false;
+		}
+		CValidationState state;
+		if (nCheckLevel >= 1 && !CheckBlockMerkleRoot(block, state)) {
+			strError = strprintf("found bad block at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+			return false;
+		}
+		if (nCheckLevel >= 2) {
+			CBlockUndo undo;
+			CDiskBlockPos pos = pindex->GetUndoPos();
+			if (!pos.IsNull() && !undo.ReadFromDisk(pos, pindex->pprev->GetBlockHash())) {
+				strError = strprintf("found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void ThreadRead()
+	{
+		while (true) {
+			size_t i;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex);
+				while (!fStop && nNextRead < vIndex.size() && nNextRead >= nNextGet + vSlots.size())
+					cond.wait(lock);
+				if (fStop || nNextRead >= vIndex.size())
+					return;
+				i = nNextRead++;
+			}
+			CBlock block;
+			std::string strError;
+			ReadAndCheck(vIndex[i], block, strError);
+			{
+				boost::unique_lock<boost::mutex> lock(mutex);
+				CSlot& slot = vSlots[i % vSlots.size()];
+				std::swap(slot.block, block);
+				slot.strError.swap(strError);
+				slot.fDone = true;
+			}
+			cond.notify_all();
+		}
+	}
+
+public:
+	CVerifyDBReader(const std::vector<CBlockIndex*>& vIndexIn, int nCheckLevelIn) : vIndex(vIndexIn), nCheckLevel(nCheckLevelIn), vSlots(std::min(VERIFYDB_READ_AHEAD, std::max(vIndexIn.size(), (size_t)1))), nNextRead(0), nNextGet(0), fStop(false)
+	{
+		int nThreads = std::max(nScriptCheckThreads, 1);
+		for (int i = 0; i < nThreads; i++)
+			threadGroup.create_thread(boost::bind(&CVerifyDBReader::ThreadRead, this));
+	}
+
+	~CVerifyDBReader()
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			fStop = true;
+		}
+		cond.notify_all();
+		threadGroup.join_all();
+	}
+
+	/** Wait for the next block, in the order of vIndex. Returns false with strError set if it failed its checks. */
+	bool GetNext(CBlock& block, std::string& strError)
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			assert(nNextGet < vIndex.size());
+			CSlot& slot = vSlots[nNextGet % vSlots.size()];
+			while (!slot.fDone)
+				cond.wait(lock);
+			std::swap(block, slot.block);
+			strError.swap(slot.strError);
+			slot.fDone = false;
+			nNextGet++;
+		}
+		cond.notify_all();
+		return strError.empty();
+	}
+};
+} // anon namespace
+
 CVerifyDB::CVerifyDB()
 {
 	uiInterface.ShowProgress(_("Verifying blocks..."), 0);
@@ -4923,56 +5478,55 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
 	CBlockIndex* pindexFailure = NULL;
 	int nGoodTransactions = 0;
 	CValidationState state;
-	for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
-		boost::this_thread::interruption_point();
-		uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
-		if (pindex->nHeight < chainActive.Height() - nCheckDepth)
-			break;
-		CBlock block;
-		// check level 0: read from disk
-		if (!ReadBlockFromDisk(block, pindex))
-			return error("VerifyDB() : *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-		// check level 1: verify block validity
-		if (nCheckLevel >= 1 && !CheckBlock(block, state))
-			return error("VerifyDB() : *** found bad block at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-		// check level 2: verify undo validity
-		if (nCheckLevel >= 2 && pindex) {
-			CBlockUndo undo;
-			CDiskBlockPos pos = pindex->GetUndoPos();
-			if (!pos.IsNull()) {
-				if (!undo.ReadFromDisk(pos, pindex->pprev->GetBlockHash()))
-					return error("VerifyDB() : *** found bad undo data at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
-			}
-		}
-		// check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-		if (nCheckLevel >= 3 && pindex == pindexState && (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) <= nCoinCacheSize) {
-			bool fClean = true;
-			if (!DisconnectBlock(block, state, pindex, coins, &fClean))
-				return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
-			pindexState = pindex->pprev;
-			if (!fClean) {
-				nGoodTransactions = 0;
-				pindexFailure = pindex;
+	std::vector<CBlockIndex*> vCheck;
+	for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev && pindex->nHeight >= chainActive.Height() - nCheckDepth; pindex = pindex->pprev)
+		vCheck.push_back(pindex);
+	{
+		// check levels 0 to 2 run ahead on the reader threads
+		CVerifyDBReader reader(vCheck, nCheckLevel);
+		for (CBlockIndex* pindex : vCheck) {
+			boost::this_thread::interruption_point();
+			uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
+			CBlock block;
+			std::string strError;
+			if (!reader.GetNext(block, strError))
+				return error("VerifyDB() : *** %s", strError);
+			// check level 1: verify block validity, the merkle root was already checked by the reader
+			if (nCheckLevel >= 1 && !CheckBlock(block, state, true, false))
+				return error("VerifyDB() : *** found bad block at %d, hash=%s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+			// check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+			if (nCheckLevel >= 3 && pindex == pindexState && (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) <= nCoinCacheSize) {
+				bool fClean = true;
+				if (!DisconnectBlock(block, state, pindex, coins, &fClean))
+					return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+				pindexState = pindex->pprev;
+				if (!fClean) {
+					nGoodTransactions = 0;
+					pindexFailure = pindex;
+				}
+				else
+					nGoodTransactions += block.vtx.size();
 			}
-			else
-				nGoodTransactions += block.vtx.size();
+			if (ShutdownRequested())
+				return true;
 		}
-		if (ShutdownRequested())
-			return true;
 	}
 	if (pindexFailure)
 		return error("VerifyDB() : *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", chainActive.Height() - pindexFailure->nHeight + 1, nGoodTransactions);
 
 	// check level 4: try reconnecting blocks
 	if (nCheckLevel >= 4) {
-		CBlockIndex* pindex = pindexState;
-		while (pindex != chainActive.Tip()) {
+		std::vector<CBlockIndex*> vConnect;
+		for (CBlockIndex* pindex = pindexState; pindex != chainActive.Tip(); pindex = chainActive.Next(pindex))
+			vConnect.push_back(chainActive.Next(pindex));
+		CVerifyDBReader reader(vConnect, 0);
+		for (CBlockIndex* pindex : vConnect) {
 			boost::this_thread::interruption_point();
 			uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * 50))));
-			pindex = chainActive.Next(pindex);
 			CBlock block;
-			if (!ReadBlockFromDisk(block, pindex))
-				return error("VerifyDB() : *** ReadBlockFromDisk failed at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
+			std::string strError;
+			if (!reader.GetNext(block, strError))
+				return error("VerifyDB() : *** %s", strError);
 			if (!ConnectBlock(block, state, pindex, coins, false))
 				return error("VerifyDB() : *** found unconnectable block at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
 		}
@@ -5041,51 +5595,215 @@ bool InitBlockIndex()
 }
 
 
+namespace {
+/** Bytes of an external block file that LoadExternalBlockFile scans ahead of the block it is connecting */
+const unsigned int IMPORT_READ_AHEAD_SIZE = 16 * 1024 * 1024;
+/** Seconds between two block import progress reports */
+const int64_t IMPORT_PROGRESS_INTERVAL = 10;
+
+/** A block record found in an external block file */
+struct CImportRecord {
+	uint64_t nRewind;  //! where to resume scanning if the record turns out to be garbage
+	uint64_t nBlockPos;
+	unsigned int nSize;
+	std::vector<char> vData;
+	CBlock block;
+	size_t nRead;
+	std::string strError;
+	bool fDone;
+	CImportRecord() : nRewind(0), nBlockPos(0), nSize(0), nRead(0), fDone(false) {}
+};
+typedef std::shared_ptr<CImportRecord> CImportRecordRef;
+
+/**
+ * Deserializes (and thereby hashes) the records found by LoadExternalBlockFile
+ * on worker threads, so that the import thread is left with scanning the file
+ * and connecting blocks.
+ */
+class CImportParser
+{
+private:
+	boost::mutex mutex;
+	boost::condition_variable cond;
+	std::deque<CImportRecordRef> queue;
+	bool fStop;
+	boost::thread_group threadGroup;
+
+	void ThreadParse()
+	{
+		while (true) {
+			CImportRecordRef record;
+			{
+				boost::unique_lock<boost::mutex> lock(mutex);
+				while (!fStop && queue.empty())
+					cond.wait(lock);
+				if (fStop)
+					return;
+				record = queue.front();
+				queue.pop_front();
+			}
+			try {
+				CMemoryReader reader(record->vData.data(), record->vData.data() + record->vData.size(), SER_DISK, CLIENT_VERSION);
+				reader >> record->block;
+				record->nRead = record->vData.size() - reader.size();
+				record->block.GetHash();
+			} catch (const std::exception& e) {
+				record->strError = e.what();
+			}
+			std::vector<char>().swap(record->vData);
+			{
+				boost::unique_lock<boost::mutex> lock(mutex);
+				record->fDone = true;
+			}
+			cond.notify_all();
+		}
+	}
+
+public:
+	CImportParser(int nThreads) : fStop(false)
+	{
+		for (int i = 0; i < nThreads; i++)
+			threadGroup.create_thread(boost::bind(&CImportParser::ThreadParse, this));
+	}
+
+	~CImportParser()
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			fStop = true;
+		}
+		cond.notify_all();
+		threadGroup.join_all();
+	}
+
+	void Submit(const CImportRecordRef& record)
+	{
+		{
+			boost::unique_lock<boost::mutex> lock(mutex);
+			queue.push_back(record);
+		}
+		cond.notify_all();
+	}
+
+	void Wait(const CImportRecordRef& record)
+	{
+		boost::unique_lock<boost::mutex> lock(mutex);
+		while (!record->fDone)
+			cond.wait(lock);
+	}
+};
+} // anon namespace
+
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 {
 	// Map of disk positions for blocks with unknown parent (only used for reindex)
 	static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
 	int64_t nStart = GetTimeMillis();
 
+	// Only for progress reports
+	uint64_t nFileSize = 0;
+	long nFileStart = ftell(fileIn);
+	if (nFileStart >= 0 && fseek(fileIn, 0, SEEK_END) == 0) {
+		long nFileEnd = ftell(fileIn);
+		if (nFileEnd > nFileStart)
+			nFileSize = nFileEnd - nFileStart;
+		fseek(fileIn, nFileStart, SEEK_SET);
+	}
+
 	int nLoaded = 0;
+	int nParsed = 0;
+	int64_t nLastProgress = GetTime();
 	try {
-		// This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-		CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
+		// This takes over fileIn and calls fclose() on it in the CBufferedFile destructor.
+		// The buffer keeps every record in flight, so the scan can resume at any of them.
+		const uint64_t nRewindSize = IMPORT_READ_AHEAD_SIZE + MAX_BLOCK_SIZE_CURRENT + 8;
+		CBufferedFile blkdat(fileIn, nRewindSize + MAX_BLOCK_SIZE_CURRENT + 8, nRewindSize, SER_DISK, CLIENT_VERSION);
+		CImportParser parser(std::max(nScriptCheckThreads, 1));
+		std::deque<CImportRecordRef> queueInFlight;
 		uint64_t nRewind = blkdat.GetPos();
-		while (!blkdat.eof()) {
+		bool fEof = false;
+		bool fAbort = false;
+		while (!fAbort) {
 			boost::this_thread::interruption_point();
 
-			blkdat.SetPos(nRewind);
-			nRewind++;         // start one byte further next time, in case of failure
-			blkdat.SetLimit(); // remove former limit
-			unsigned int nSize = 0;
-			try {
-				// locate a header
-				unsigned char buf[MESSAGE_START_SIZE];
-				blkdat.FindByte(Params().MessageStart()[0]);
-				nRewind = blkdat.GetPos() + 1;
-				blkdat >> FLATDATA(buf);
-				if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
-					continue;
-				// read size
-				blkdat >> nSize;
-				if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
-					continue;
+			// Scan for records ahead of the block being connected
+			while (!fEof && (queueInFlight.empty() || blkdat.GetPos() < queueInFlight.front()->nRewind + IMPORT_READ_AHEAD_SIZE)) {
+				if (blkdat.eof()) {
+					fEof = true;
+					break;
+				}
+				blkdat.SetPos(nRewind);
+				nRewind++;         // start one byte further next time, in case of failure
+				blkdat.SetLimit(); // remove former limit
+				unsigned int nSize = 0;
+				try {
+					// locate a header
+					unsigned char buf[MESSAGE_START_SIZE];
+					blkdat.FindByte(Params().MessageStart()[0]);
+					nRewind = blkdat.GetPos() + 1;
+					blkdat >> FLATDATA(buf);
+					if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+						continue;
+					// read size
+					blkdat >> nSize;
+					if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+						continue;
+				}
+				catch (const std::exception&) {
+					// no valid block header found; don't complain
+					fEof = true;
+					break;
+				}
+				try {
+					// read the raw block, it is deserialized by the parser threads
+					CImportRecordRef record = std::make_shared<CImportRecord>();
+					record->nRewind = nRewind;
+					record->nBlockPos = blkdat.GetPos();
+					record->nSize = nSize;
+					blkdat.SetLimit(record->nBlockPos + nSize);
+					record->vData.resize(nSize);
+					blkdat.read(record->vData.data(), nSize);
+					nRewind = blkdat.GetPos();
+					parser.Submit(record);
+					queueInFlight.push_back(record);
+				}
+				catch (const std::exception& e) {
+					LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+				}
 			}
-			catch (const std::exception&) {
-				// no valid block header found; don't complain
+			if (queueInFlight.empty())
 				break;
+
+			CImportRecordRef record = queueInFlight.front();
+			queueInFlight.pop_front();
+			parser.Wait(record);
+			if (!record->strError.empty()) {
+				LogPrintf("%s : Deserialize or I/O error - %s", __func__, record->strError);
+				// Scan again from just after this record's header, dropping what was read past it
+				nRewind = record->nRewind;
+				queueInFlight.clear();
+				fEof = false;
+				continue;
+			}
+			nParsed++;
+			if (record->nRead < record->nSize) {
+				// The block ended before the record did, scan on from its end like a serial read would
+				nRewind = record->nBlockPos + record->nRead;
+				queueInFlight.clear();
+				fEof = false;
 			}
+
+			if (GetTime() - nLastProgress >= IMPORT_PROGRESS_INTERVAL) {
+				double dElapsed = std::max(GetTimeMillis() - nStart, (int64_t)1) / 1000.0;
+				LogPrintf("Block Import: %d blocks read, %d new, %.1f/%.1f MB (%.1f blocks/s, %.1f MB/s)\n", nParsed, nLoaded,
+					record->nBlockPos / 1048576.0, nFileSize / 1048576.0, nParsed / dElapsed, record->nBlockPos / 1048576.0 / dElapsed);
+				nLastProgress = GetTime();
+			}
+
 			try {
-				// read block
-				uint64_t nBlockPos = blkdat.GetPos();
+				CBlock& block = record->block;
 				if (dbp)
-					dbp->nPos = nBlockPos;
-				blkdat.SetLimit(nBlockPos + nSize);
-				blkdat.SetPos(nBlockPos);
-				CBlock block;
-				blkdat >> block;
-				nRewind = blkdat.GetPos();
+					dbp->nPos = record->nBlockPos;
 
 				// detect out of order blocks, and store them for later
 				uint256 hash = block.GetHash();
@@ -5102,8 +5820,10 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 					CValidationState state;
 					if (ProcessNewBlock(state, NULL, &block, dbp))
 						nLoaded++;
-					if (state.IsError())
+					if (state.IsError()) {
+						fAbort = true;
 						break;
+					}
 				}
 				else if (hash != Params().HashGenesisBlock() && mapBlockIndex[hash]->nHeight % 1000 == 0) {
 					LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
@@ -5140,8 +5860,11 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 	catch (std::runtime_error& e) {
 		AbortNode(std::string("System error: ") + e.what());
 	}
-	if (nLoaded > 0)
-		LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+	if (nLoaded > 0) {
+		int64_t nElapsed = std::max(GetTimeMillis() - nStart, (int64_t)1);
+		LogPrintf("Loaded %i blocks from external file in %dms (%.1f blocks/s, %.1f MB/s)\n", nLoaded, nElapsed,
+			nParsed * 1000.0 / nElapsed, nFileSize / 1048.576 / nElapsed);
+	}
 	return nLoaded > 0;
 }
 
@@ -5452,14 +6175,25 @@ void static ProcessGetData(CNode* pfrom)
 				}
 				// Don't send not-validated blocks
 				if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-					// Send block from disk
-					CBlock block;
-					if (!ReadBlockFromDisk(block, (*mi).second))
-						assert(!"cannot load block from disk");
-					if (inv.type == MSG_BLOCK)
-						pfrom->PushMessage("block", block);
+					if (inv.type == MSG_BLOCK) {
+						// Send the serialized block straight from the block file. A stored block
+						// never moves, so cs_main is released while the bytes are read.
+						const CDiskBlockPos pos = mi->second->GetBlockPos();
+						CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+						LEAVE_CRITICAL_SECTION(cs_main);
+						bool fRead = ReadRawBlockFromDisk(ssBlock, pos, inv.hash);
+						ENTER_CRITICAL_SECTION(cs_main);
+						if (!fRead)
+							assert(!"cannot load block from disk");
+						pfrom->PushMessage("block", ssBlock);
+					}
 					else // MSG_FILTERED_BLOCK)
 					{
+						// Send block from disk, sharing the cached copy instead of deserializing it again
+						CBlockRef pblock;
+						if (!ReadBlockFromDisk(pblock, (*mi).second))
+							assert(!"cannot load block from disk");
+						const CBlock& block = *pblock;
 						LOCK(pfrom->cs_filter);
 						if (pfrom->pfilter) {
 							CMerkleBlock merkleBlock(block, *pfrom->pfilter);
@@ -6902,19 +7636,34 @@ bool CBlockUndo::WriteToDisk(CDiskBlockPos& pos, const uint256& hashBlock)
 
 bool CBlockUndo::ReadFromDisk(const CDiskBlockPos& pos, const uint256& hashBlock)
 {
-	// Open history file to read
-	CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-	if (filein.IsNull())
-		return error("CBlockUndo::ReadFromDisk : OpenBlockFile failed");
-
-	// Read block
 	uint256 hashChecksum;
-	try {
-		filein >> *this;
-		filein >> hashChecksum;
+	unsigned int nSize;
+	CMappedFileRef pfile = MapDiskRecord(pos, "rev", sizeof(hashChecksum), nSize);
+	if (pfile) {
+		// Deserialize straight from the mapped file
+		try {
+			CMemoryReader reader(pfile->begin() + pos.nPos, pfile->begin() + pos.nPos + nSize + sizeof(hashChecksum), SER_DISK, CLIENT_VERSION);
+			reader >> *this;
+			reader >> hashChecksum;
+		}
+		catch (std::exception& e) {
+			return error("%s : Deserialize error - %s", __func__, e.what());
+		}
 	}
-	catch (std::exception& e) {
-		return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+	else {
+		// Open history file to read
+		CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+		if (filein.IsNull())
+			return error("CBlockUndo::ReadFromDisk : OpenBlockFile failed");
+
+		// Read block
+		try {
+			filein >> *this;
+			filein >> hashChecksum;
+		}
+		catch (std::exception& e) {
+			return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+		}
 	}
 
 	// Verify checksum
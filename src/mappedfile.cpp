@@ -0,0 +1,85 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "mappedfile.h"
+
+#include "compat.h"
+#include "util.h"
+
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+CMappedFileCache mappedBlockFiles(MAX_MAPPED_BLOCK_FILES);
+
+CMappedFile::CMappedFile(const boost::filesystem::path& path) : pbegin(NULL), nSize(0)
+{
+#ifndef WIN32
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            pbegin = (char*)p;
+            nSize = st.st_size;
+        } else {
+            LogPrintf("%s : mmap of %s failed: %s\n", __func__, path.string(), strerror(errno));
+        }
+    }
+    // The mapping keeps its own reference to the file
+    close(fd);
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+#ifndef WIN32
+    if (pbegin)
+        munmap(pbegin, nSize);
+#endif
+}
+
+CMappedFileCache::CMappedFileCache(size_t nMaxFilesIn) : nMaxFiles(nMaxFilesIn), nUseCounter(0) {}
+
+CMappedFileRef CMappedFileCache::Get(const boost::filesystem::path& path, size_t nMinSize)
+{
+    LOCK(cs);
+    if (nMaxFiles == 0)
+        return CMappedFileRef();
+
+    const std::string strPath = path.string();
+    std::map<std::string, CEntry>::iterator it = mapFiles.find(strPath);
+    if (it != mapFiles.end() && it->second.pfile->size() >= nMinSize) {
+        it->second.nLastUse = ++nUseCounter;
+        return it->second.pfile;
+    }
+
+    CMappedFileRef pfile = std::make_shared<const CMappedFile>(path);
+    if (pfile->IsNull() || pfile->size() < nMinSize)
+        return CMappedFileRef();
+
+    if (it == mapFiles.end() && mapFiles.size() >= nMaxFiles) {
+        std::map<std::string, CEntry>::iterator itOldest = mapFiles.begin();
+        for (std::map<std::string, CEntry>::iterator itEntry = mapFiles.begin(); itEntry != mapFiles.end(); ++itEntry) {
+            if (itEntry->second.nLastUse < itOldest->second.nLastUse)
+                itOldest = itEntry;
+        }
+        mapFiles.erase(itOldest);
+    }
+    CEntry& entry = mapFiles[strPath];
+    entry.pfile = pfile;
+    entry.nLastUse = ++nUseCounter;
+    return pfile;
+}
+
+void CMappedFileCache::Clear()
+{
+    LOCK(cs);
+    mapFiles.clear();
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef Aratriton_MAPPEDFILE_H
+#define Aratriton_MAPPEDFILE_H
+
+#include "sync.h"
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+#include <boost/filesystem/path.hpp>
+
+/** Maximum number of block and undo files kept mapped at once (0 on 32-bit, where address space is scarce) */
+static const size_t MAX_MAPPED_BLOCK_FILES = sizeof(void*) >= 8 ? 256 : 0;
+
+/** Read-only memory mapping of a whole file. The mapping stays valid as long
+ * as the file is not truncated, so only map files that are no longer written.
+ */
+class CMappedFile
+{
+private:
+    // Disallow copies
+    CMappedFile(const CMappedFile&);
+    CMappedFile& operator=(const CMappedFile&);
+
+    char* pbegin;
+    size_t nSize;
+
+public:
+    explicit CMappedFile(const boost::filesystem::path& path);
+    ~CMappedFile();
+
+    bool IsNull() const { return pbegin == NULL; }
+    const char* begin() const { return pbegin; }
+    const char* end() const { return pbegin + nSize; }
+    size_t size() const { return nSize; }
+};
+
+typedef std::shared_ptr<const CMappedFile> CMappedFileRef;
+
+/** Cache of mapped files, so repeated reads from the same file need no
+ * open/seek/read system calls. Least recently used mappings are dropped
+ * once nMaxFiles is reached; readers still holding one keep it alive.
+ */
+class CMappedFileCache
+{
+private:
+    struct CEntry {
+        CMappedFileRef pfile;
+        uint64_t nLastUse;
+    };
+
+    CCriticalSection cs;
+    std::map<std::string, CEntry> mapFiles;
+    size_t nMaxFiles;
+    uint64_t nUseCounter;
+
+public:
+    explicit CMappedFileCache(size_t nMaxFilesIn);
+
+    /** Return a mapping of path that is at least nMinSize bytes long, remapping
+     * the file if it has grown since it was mapped. Returns NULL if the file
+     * cannot be mapped, in which case the caller should fall back to stdio.
+     */
+    CMappedFileRef Get(const boost::filesystem::path& path, size_t nMinSize);
+
+    void Clear();
+};
+
+extern CMappedFileCache mappedBlockFiles;
+
+#endif // Aratriton_MAPPEDFILE_H
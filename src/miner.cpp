@@ -32,7 +32,9 @@
 
 
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple.hpp>
+
+#include <atomic>
+#include <queue>
 
 using namespace std;
 
@@ -41,55 +43,66 @@ using namespace std;
 // AratritonMiner
 //
 
-//
-// Unconfirmed transactions in the memory pool often depend on other
-// transactions in the memory pool. When we select transactions from the
-// pool, we select by highest priority or fee rate, so we might consider
-// transactions that depend on transactions that aren't yet in the block.
-// The COrphan class keeps track of these 'temporary orphans' while
-// CreateBlock is figuring out which transactions to include.
-//
-class COrphan
+uint64_t nLastBlockTx = 0;
+uint64_t nLastBlockSize = 0;
+int64_t nLastCoinStakeSearchInterval = 0;
+
+// We want to sort transactions by priority, so:
+typedef std::pair<double, CTxMemPool::txiter> TxCoinAgePriority;
+class TxCoinAgePriorityCompare
 {
 public:
-	const CTransaction* ptx;
-	set<uint256> setDependsOn;
-	CFeeRate feeRate;
-	double dPriority;
-
-	COrphan(const CTransaction* ptxIn) : ptx(ptxIn), feeRate(0), dPriority(0)
+	bool operator()(const TxCoinAgePriority& a, const TxCoinAgePriority& b)
 	{
+		if (a.first == b.first)
+			return CompareTxMemPoolEntryByAncestorFee()(*(b.second), *(a.second)); // Reverse order to make sort less than
+		return a.first < b.first;
 	}
 };
 
-uint64_t nLastBlockTx = 0;
-uint64_t nLastBlockSize = 0;
-int64_t nLastCoinStakeSearchInterval = 0;
-
-// We want to sort transactions by priority and fee rate, so:
-typedef boost::tuple<double, CFeeRate, const CTransaction*> TxPriority;
-class TxPriorityCompare
+// Children whose parents made it into the block are retried best package first
+class TxAncestorScoreCompare
 {
-	bool byFee;
-
 public:
-	TxPriorityCompare(bool _byFee) : byFee(_byFee) {}
-
-	bool operator()(const TxPriority& a, const TxPriority& b)
+	bool operator()(const CTxMemPool::txiter& a, const CTxMemPool::txiter& b)
 	{
-		if (byFee) {
-			if (a.get<1>() == b.get<1>())
-				return a.get<0>() < b.get<0>();
-			return a.get<1>() < b.get<1>();
-		}
-		else {
-			if (a.get<0>() == b.get<0>())
-				return a.get<1>() < b.get<1>();
-			return a.get<0>() < b.get<0>();
-		}
+		return CompareTxMemPoolEntryByAncestorFee()(*b, *a);
 	}
 };
 
+static double GetTxPriority(const CTxMemPoolEntry& entry, int nHeight)
+{
+	const CTransaction& tx = entry.GetTx();
+	if (!tx.IsZerocoinSpend())
+		return entry.GetPriority(nHeight);
+
+	//Give a high priority to zerocoinspends to get into the next block
+	//Priority = (age^6+100000)*amount - gives higher priority to zaras that have been in mempool long
+	//and higher priority to zaras that are large in value
+	const uint256 txid = tx.GetHash();
+	int64_t nTimeSeen = GetAdjustedTime();
+	double nConfs = 100000;
+
+	auto it = mapZerocoinspends.find(txid);
+	if (it != mapZerocoinspends.end()) {
+		nTimeSeen = it->second;
+	}
+	else {
+		//for some reason not in map, add it
+		mapZerocoinspends[txid] = nTimeSeen;
+	}
+
+	double nTimePriority = std::pow(GetAdjustedTime() - nTimeSeen, 6);
+	CAmount nTotalIn = tx.GetZerocoinSpent();
+	double dPriority = 0;
+	for (unsigned int i = 0; i < tx.vin.size(); i++) {
+		// zARA spends can have very large priority, use non-overflowing safe functions
+		dPriority = double_safe_addition(dPriority, (nTimePriority * nConfs));
+		dPriority = double_safe_multiplication(dPriority, nTotalIn);
+	}
+	return tx.ComputePriority(dPriority, entry.GetTxSize());
+}
+
 void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
 {
 	pblock->nTime = std::max(pindexPrev->GetMedianTimePast() + 1, GetAdjustedTime());
@@ -185,146 +198,144 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 		const int nHeight = pindexPrev->nHeight + 1;
 		CCoinsViewCache view(pcoinsTip);
 
-		// Priority order to process transactions
-		list<COrphan> vOrphan; // list memory doesn't move
-		map<uint256, vector<COrphan*> > mapDependers;
 		bool fPrintPriority = GetBoolArg("-printpriority", false);
 
+		// Transactions are taken straight from the mempool's ancestor feerate
+		// index, which the mempool keeps sorted as transactions come and go,
+		// so the work done here grows with the block and not with the pool.
+		uint64_t nBlockSize = 1000;
+		uint64_t nBlockTx = 0;
+		int nBlockSigOps = 100;
+		int lastFewTxs = 0;
+		bool fPriorityBlock = nBlockPrioritySize > 0;
+		bool fFreeTail = false;
+
+		CTxMemPool::setEntries inBlock;
+		CTxMemPool::setEntries waitSet;
+
 		// This vector will be sorted into a priority queue:
-		vector<TxPriority> vecPriority;
-		vecPriority.reserve(mempool.mapTx.size());
-		for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
-			mi != mempool.mapTx.end(); ++mi) {
-			const CTransaction& tx = mi->second.GetTx();
-			if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight)) {
-				continue;
-			}
-			if (GetAdjustedTime() > GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE) && tx.ContainsZerocoins()) {
-				continue;
+		vector<TxCoinAgePriority> vecPriority;
+		TxCoinAgePriorityCompare pricomparer;
+		std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash> waitPriMap;
+		typedef std::map<CTxMemPool::txiter, double, CTxMemPool::CompareIteratorByHash>::iterator waitPriIter;
+		double actualPriority = -1;
+
+		std::priority_queue<CTxMemPool::txiter, std::vector<CTxMemPool::txiter>, TxAncestorScoreCompare> clearedTxs;
+
+		// Coin age priority changes with every block, so the priority area is
+		// the one part that still looks at every entry. The entries carry
+		// their priority, so this needs no coin lookups.
+		if (fPriorityBlock) {
+			vecPriority.reserve(mempool.mapTx.size());
+			for (CTxMemPool::indexed_transaction_set::iterator mi = mempool.mapTx.begin();
+				mi != mempool.mapTx.end(); ++mi) {
+				double dPriority = GetTxPriority(*mi, nHeight);
+				CAmount dummy = 0;
+				mempool.ApplyDeltas(mi->GetTx().GetHash(), dPriority, dummy);
+				vecPriority.push_back(TxCoinAgePriority(dPriority, mi));
 			}
+			std::make_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+		}
+
+		CTxMemPool::indexed_transaction_set::index<ancestor_score>::type::iterator mi = mempool.mapTx.get<ancestor_score>().begin();
+		CTxMemPool::txiter iter;
 
-			COrphan* porphan = NULL;
-			double dPriority = 0;
-			CAmount nTotalIn = 0;
-			bool fMissingInputs = false;
-			uint256 txid = tx.GetHash();
-			for (const CTxIn& txin : tx.vin) {
-				//zerocoinspend has special vin
-				if (tx.IsZerocoinSpend()) {
-					nTotalIn = tx.GetZerocoinSpent();
-
-					//Give a high priority to zerocoinspends to get into the next block
-					//Priority = (age^6+100000)*amount - gives higher priority to zaras that have been in mempool long
-					//and higher priority to zaras that are large in value
-					int64_t nTimeSeen = GetAdjustedTime();
-					double nConfs = 100000;
-
-					auto it = mapZerocoinspends.find(txid);
-					if (it != mapZerocoinspends.end()) {
-						nTimeSeen = it->second;
+		vector<CBigNum> vBlockSerials;
+		vector<CBigNum> vTxSerials;
+		while (mi != mempool.mapTx.get<ancestor_score>().end() || !clearedTxs.empty()) {
+			bool priorityTx = false;
+			if (fPriorityBlock && !vecPriority.empty()) { // add a tx from priority queue to fill the blockprioritysize
+				priorityTx = true;
+				iter = vecPriority.front().second;
+				actualPriority = vecPriority.front().first;
+				std::pop_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+				vecPriority.pop_back();
+			}
+			else if (clearedTxs.empty()) { // add tx with next highest score
+				iter = mempool.mapTx.project<0>(mi);
+				mi++;
+
+				// The rest of the index pays less than the relay fee. Of those only
+				// zerocoin spends and prioritised transactions may still go in, so
+				// look them up directly instead of walking the remainder of the pool.
+				if (!fFreeTail && nBlockSize >= nBlockMinSize &&
+					CFeeRate(iter->GetFeesWithAncestors(), iter->GetSizeWithAncestors()) < ::minRelayTxFee) {
+					fFreeTail = true;
+					mi = mempool.mapTx.get<ancestor_score>().end();
+					for (const auto& it : mapZerocoinspends) {
+						CTxMemPool::txiter spendit = mempool.mapTx.find(it.first);
+						if (spendit != mempool.mapTx.end() && !inBlock.count(spendit))
+							clearedTxs.push(spendit);
 					}
-					else {
-						//for some reason not in map, add it
-						mapZerocoinspends[txid] = nTimeSeen;
+					for (const auto& it : mempool.mapDeltas) {
+						CTxMemPool::txiter deltait = mempool.mapTx.find(it.first);
+						if (deltait != mempool.mapTx.end() && !inBlock.count(deltait) && (it.second.first > 0 || it.second.second > 0))
+							clearedTxs.push(deltait);
 					}
-
-					double nTimePriority = std::pow(GetAdjustedTime() - nTimeSeen, 6);
-
-					// zARA spends can have very large priority, use non-overflowing safe functions
-					dPriority = double_safe_addition(dPriority, (nTimePriority * nConfs));
-					dPriority = double_safe_multiplication(dPriority, nTotalIn);
-
 					continue;
 				}
+			}
+			else { // try to add a previously postponed child tx
+				iter = clearedTxs.top();
+				clearedTxs.pop();
+			}
 
-				// Read prev transaction
-				if (!view.HaveCoins(txin.prevout.hash)) {
-					// This should never happen; all transactions in the memory
-					// pool should connect to either transactions in the chain
-					// or other transactions in the memory pool.
-					if (!mempool.mapTx.count(txin.prevout.hash)) {
-						LogPrintf("ERROR: mempool transaction missing input\n");
-						if (fDebug) assert("mempool transaction missing input" == 0);
-						fMissingInputs = true;
-						if (porphan)
-							vOrphan.pop_back();
-						break;
-					}
+			if (inBlock.count(iter))
+				continue; // could have been added to the priorityBlock
 
-					// Has to wait for dependencies
-					if (!porphan) {
-						// Use list for automatic deletion
-						vOrphan.push_back(COrphan(&tx));
-						porphan = &vOrphan.back();
-					}
-					mapDependers[txin.prevout.hash].push_back(porphan);
-					porphan->setDependsOn.insert(txin.prevout.hash);
-					nTotalIn += mempool.mapTx[txin.prevout.hash].GetTx().vout[txin.prevout.n].nValue;
-					continue;
-				}
+			const CTransaction& tx = iter->GetTx();
+			const uint256& hash = tx.GetHash();
+			if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight)) {
+				continue;
+			}
+			if (GetAdjustedTime() > GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE) && tx.ContainsZerocoins()) {
+				continue;
+			}
 
-				//Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
-				if (invalid_out::ContainsOutPoint(txin.prevout)) {
-					LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
-					fMissingInputs = true;
+			// Has to wait for its in-mempool parents
+			bool fOrphan = false;
+			BOOST_FOREACH (CTxMemPool::txiter parent, mempool.GetMemPoolParents(iter)) {
+				if (!inBlock.count(parent)) {
+					fOrphan = true;
 					break;
 				}
-
-				const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-				assert(coins);
-
-				CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
-				nTotalIn += nValueIn;
-
-				int nConf = nHeight - coins->nHeight;
-
-				// zARA spends can have very large priority, use non-overflowing safe functions
-				dPriority = double_safe_addition(dPriority, ((double)nValueIn * nConf));
-
 			}
-			if (fMissingInputs) continue;
-
-			// Priority is sum(valuein * age) / modified_txsize
-			unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-			dPriority = tx.ComputePriority(dPriority, nTxSize);
-
-			uint256 hash = tx.GetHash();
-			mempool.ApplyDeltas(hash, dPriority, nTotalIn);
-
-			CFeeRate feeRate(nTotalIn - tx.GetValueOut(), nTxSize);
-
-			if (porphan) {
-				porphan->dPriority = dPriority;
-				porphan->feeRate = feeRate;
+			if (fOrphan) {
+				if (priorityTx)
+					waitPriMap.insert(std::make_pair(iter, actualPriority));
+				else
+					waitSet.insert(iter);
+				continue;
 			}
-			else
-				vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->second.GetTx()));
-		}
-
-		// Collect transactions into block
-		uint64_t nBlockSize = 1000;
-		uint64_t nBlockTx = 0;
-		int nBlockSigOps = 100;
-		bool fSortedByFee = (nBlockPrioritySize <= 0);
 
-		TxPriorityCompare comparer(fSortedByFee);
-		std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+			unsigned int nTxSize = iter->GetTxSize();
 
-		vector<CBigNum> vBlockSerials;
-		vector<CBigNum> vTxSerials;
-		while (!vecPriority.empty()) {
-			// Take highest priority transaction off the priority queue:
-			double dPriority = vecPriority.front().get<0>();
-			CFeeRate feeRate = vecPriority.front().get<1>();
-			const CTransaction& tx = *(vecPriority.front().get<2>());
+			// Prioritise by fee once past the priority size or we run out of high-priority
+			// transactions:
+			if (fPriorityBlock &&
+				((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(actualPriority))) {
+				fPriorityBlock = false;
+				waitPriMap.clear();
+			}
 
-			std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-			vecPriority.pop_back();
+			// Skip free transactions if we're past the minimum block size:
+			double dPriorityDelta = 0;
+			CAmount nFeeDelta = 0;
+			mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
+			CFeeRate feeRate(iter->GetFee() + nFeeDelta, nTxSize);
+			if (!priorityTx && !tx.IsZerocoinSpend() && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+				continue;
 
 			// Size limits
-			unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-			if (nBlockSize + nTxSize >= nBlockMaxSize)
+			if (nBlockSize + nTxSize >= nBlockMaxSize) {
+				if (nBlockSize > nBlockMaxSize - 100 || lastFewTxs > 50)
+					break;
+				// Once we're within 5000 bytes of a full block, only look at 50 more txs
+				// to try to fill the remaining space.
+				if (nBlockSize > nBlockMaxSize - 5000)
+					lastFewTxs++;
 				continue;
+			}
 
 			// Legacy limits on sigOps:
 			unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
@@ -332,33 +343,31 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 			if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
 				continue;
 
-			// Skip free transactions if we're past the minimum block size:
-			const uint256& hash = tx.GetHash();
-			double dPriorityDelta = 0;
-			CAmount nFeeDelta = 0;
-			mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-			if (!tx.IsZerocoinSpend() && fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+			if (!view.HaveInputs(tx))
 				continue;
 
-			// Prioritise by fee once past the priority size or we run out of high-priority
-			// transactions:
-			if (!fSortedByFee &&
-				((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
-				fSortedByFee = true;
-				comparer = TxPriorityCompare(fSortedByFee);
-				std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+			//Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
+			bool fInvalidInput = false;
+			if (!tx.IsZerocoinSpend()) {
+				for (const CTxIn& txin : tx.vin) {
+					if (invalid_out::ContainsOutPoint(txin.prevout)) {
+						LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
+						fInvalidInput = true;
+						break;
+					}
+				}
 			}
-
-			if (!view.HaveInputs(tx))
+			if (fInvalidInput)
 				continue;
 
 			// double check that there are no double spent zARA spends in this block or tx
 			if (tx.IsZerocoinSpend()) {
 				int nHeightTx = 0;
-				if (IsTransactionInChain(tx.GetHash(), nHeightTx))
+				if (IsSpendTxInBlockchain(tx.GetHash(), nHeightTx))
 					continue;
 
 				bool fDoubleSerial = false;
+				vTxSerials.clear();
 				for (const CTxIn& txIn : tx.vin) {
 					if (txIn.scriptSig.IsZerocoinSpend()) {
 						libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
@@ -404,23 +413,33 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 			nBlockSigOps += nTxSigOps;
 			nFees += nTxFees;
 
-			for (const CBigNum& bnSerial : vTxSerials)
-				vBlockSerials.emplace_back(bnSerial);
+			if (tx.IsZerocoinSpend()) {
+				for (const CBigNum& bnSerial : vTxSerials)
+					vBlockSerials.emplace_back(bnSerial);
+			}
 
 			if (fPrintPriority) {
+				double dPriority = priorityTx ? actualPriority : GetTxPriority(*iter, nHeight);
 				LogPrintf("priority %.1f fee %s txid %s\n",
 					dPriority, feeRate.ToString(), tx.GetHash().ToString());
 			}
 
+			inBlock.insert(iter);
+
 			// Add transactions that depend on this one to the priority queue
-			if (mapDependers.count(hash)) {
-				BOOST_FOREACH(COrphan* porphan, mapDependers[hash]) {
-					if (!porphan->setDependsOn.empty()) {
-						porphan->setDependsOn.erase(hash);
-						if (porphan->setDependsOn.empty()) {
-							vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-							std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-						}
+			BOOST_FOREACH (CTxMemPool::txiter child, mempool.GetMemPoolChildren(iter)) {
+				if (fPriorityBlock) {
+					waitPriIter wpiter = waitPriMap.find(child);
+					if (wpiter != waitPriMap.end()) {
+						vecPriority.push_back(TxCoinAgePriority(wpiter->second, child));
+						std::push_heap(vecPriority.begin(), vecPriority.end(), pricomparer);
+						waitPriMap.erase(wpiter);
+					}
+				}
+				else {
+					if (waitSet.count(child)) {
+						clearedTxs.push(child);
+						waitSet.erase(child);
 					}
 				}
 			}
@@ -575,6 +594,48 @@ bool fGenerateBitcoins = false;
 bool fMintableCoins = false;
 int nMintableLastCheck = 0;
 
+// Conditions that have no event to wake the staker (peers, masternode sync,
+// coins maturing) are checked again after this many seconds
+static const int64_t STAKE_IDLE_RECHECK = 30;
+
+static boost::mutex csStakeWake;
+static boost::condition_variable condStakeWake;
+static bool fStakeWake = false;
+static std::atomic<int64_t> nNextStakeAttempt(0);
+
+void WakeStakeMinter()
+{
+	{
+		boost::lock_guard<boost::mutex> lock(csStakeWake);
+		fStakeWake = true;
+	}
+	condStakeWake.notify_all();
+}
+
+int64_t GetNextStakeAttemptTime()
+{
+	return nNextStakeAttempt;
+}
+
+// Sleep the staking thread until nWakeTime, or less if WakeStakeMinter() is
+// called in the meantime. Returns whether it was woken early.
+static bool WaitForStakeEvent(int64_t nWakeTime)
+{
+	nNextStakeAttempt = nWakeTime;
+	int64_t nWaitMillis = max((nWakeTime - GetTime()) * 1000, (int64_t)0);
+	boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(nWaitMillis);
+
+	bool fWoken;
+	{
+		boost::unique_lock<boost::mutex> lock(csStakeWake);
+		while (!fStakeWake && condStakeWake.timed_wait(lock, deadline)) {}
+		fWoken = fStakeWake;
+		fStakeWake = false;
+	}
+	nNextStakeAttempt = GetTime();
+	return fWoken;
+}
+
 // ***TODO*** that part changed in bitcoin, we are using a mix with old one here for now
 
 void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
@@ -587,6 +648,14 @@ void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
 	CReserveKey reservekey(pwallet);
 	unsigned int nExtraNonce = 0;
 
+	// The staker waits for the next hash slot, but a new tip or a change in the wallet wakes it
+	boost::signals2::scoped_connection connBlockTip, connWalletTx, connWalletStatus;
+	if (fProofOfStake) {
+		connBlockTip = GetMainSignals().UpdatedBlockTip.connect(boost::bind(&WakeStakeMinter));
+		connWalletTx = pwallet->NotifyTransactionChanged.connect(boost::bind(&WakeStakeMinter));
+		connWalletStatus = pwallet->NotifyStatusChanged.connect(boost::bind(&WakeStakeMinter));
+	}
+
 	while (fGenerateBitcoins || fProofOfStake) {
 		if (fProofOfStake) {
 			//control the amount of times the client will check for mintable coins
@@ -597,11 +666,11 @@ void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
 			}
 
 			if (chainActive.Tip()->nHeight < Params().LAST_POW_BLOCK()) {
-				MilliSleep(5000);
+				WaitForStakeEvent(GetTime() + STAKE_IDLE_RECHECK);
 				continue;
 			}
 
-			while (vNodes.empty() || pwallet->IsLocked() || !fMintableCoins || (pwallet->GetBalance() > 0 && nReserveBalance >= pwallet->GetBalance()) || !masternodeSync.IsSynced()) {
+			while (vNodes.empty() || pwallet->IsLocked() || !fMintableCoins || (pwallet->GetStakingBalance() > 0 && nReserveBalance >= pwallet->GetStakingBalance()) || !masternodeSync.IsSynced()) {
 				nLastCoinStakeSearchInterval = 0;
 				// Do a separate 1 minute check here to ensure fMintableCoins is updated
 				if (!fMintableCoins) {
@@ -611,16 +680,19 @@ void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
 						fMintableCoins = pwallet->MintableCoins();
 					}
 				}
-				MilliSleep(5000);
+				// A wallet change may have made coins mintable, so look again right away
+				if (WaitForStakeEvent(GetTime() + STAKE_IDLE_RECHECK))
+					nMintableLastCheck = 0;
 				if (!fGenerateBitcoins && !fProofOfStake)
 					continue;
 			}
 
 			if (mapHashedBlocks.count(chainActive.Tip()->nHeight)) //search our map of hashed blocks, see if bestblock has been hashed yet
 			{
-				if (GetTime() - mapHashedBlocks[chainActive.Tip()->nHeight] < max(pwallet->nHashInterval, (unsigned int)1)) // wait half of the nHashDrift with max wait of 3 minutes
+				int64_t nNextHashTime = mapHashedBlocks[chainActive.Tip()->nHeight] + max(pwallet->nHashInterval, (unsigned int)1);
+				if (GetTime() < nNextHashTime) // wait half of the nHashDrift with max wait of 3 minutes
 				{
-					MilliSleep(5000);
+					WaitForStakeEvent(nNextHashTime);
 					continue;
 				}
 			}
@@ -635,8 +707,12 @@ void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
 			continue;
 
 		unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlockWithKey(reservekey, pwallet, fProofOfStake));
-		if (!pblocktemplate.get())
+		if (!pblocktemplate.get()) {
+			// Nothing was hashed on this tip, e.g. no input is old enough yet, so wait rather than spin
+			if (fProofOfStake && !mapHashedBlocks.count(chainActive.Tip()->nHeight))
+				WaitForStakeEvent(min(GetTime() + STAKE_IDLE_RECHECK, pwallet->GetStakeCandidates()->nRefreshTime));
 			continue;
+		}
 
 		CBlock* pblock = &pblocktemplate->block;
 		IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
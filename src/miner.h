@@ -29,6 +29,10 @@ void IncrementExtraNonce(CBlock* pblock, CBlockIndex* pindexPrev, unsigned int&
 void UpdateTime(CBlockHeader* block, const CBlockIndex* pindexPrev);
 
 void BitcoinMiner(CWallet* pwallet, bool fProofOfStake);
+/** Make the staking thread try again now instead of at its next hash slot */
+void WakeStakeMinter();
+/** When the staking thread tries to stake next (unix time), 0 if it has not run yet */
+int64_t GetNextStakeAttemptTime();
 
 extern double dHashesPerSec;
 extern int64_t nHPSTimerStart;
@@ -119,6 +119,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"reservebalance", 0},
         {"reservebalance", 1},
         {"setstakesplitthreshold", 0},
+        {"simulatestaking", 0},
         {"autocombinerewards", 0},
         {"autocombinerewards", 1},
         {"getaccumulatorvalues", 0},
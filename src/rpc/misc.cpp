@@ -11,6 +11,7 @@
 #include "init.h"
 #include "main.h"
 #include "masternode-sync.h"
+#include "miner.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
@@ -561,6 +562,8 @@ UniValue getstakingstatus(const UniValue& params, bool fHelp)
             "  \"enoughcoins\": true|false,        (boolean) if available coins are greater than reserve balance\n"
             "  \"mnsync\": true|false,             (boolean) if masternode data is synced\n"
             "  \"staking status\": true|false,     (boolean) if the wallet is staking or not\n"
+            "  \"nextstakeattempt\": ttt,          (numeric) when the staker hashes next, in seconds since epoch (0 if it is not running)\n"
+            "  \"nextstakeattemptin\": n,          (numeric) seconds until then\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -589,6 +592,10 @@ UniValue getstakingstatus(const UniValue& params, bool fHelp)
         nStaking = true;
     obj.push_back(Pair("staking status", nStaking));
 
+    int64_t nNextStakeAttempt = GetNextStakeAttemptTime();
+    obj.push_back(Pair("nextstakeattempt", nNextStakeAttempt));
+    obj.push_back(Pair("nextstakeattemptin", nNextStakeAttempt ? std::max(nNextStakeAttempt - GetTime(), (int64_t)0) : 0));
+
     return obj;
 }
 #endif // ENABLE_WALLET
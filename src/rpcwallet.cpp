@@ -13,6 +13,7 @@
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
+#include "script/sign.h"
 #include "timedata.h"
 #include "util.h"
 #include "utilmoneystr.h"
@@ -2246,6 +2247,146 @@ UniValue getstakesplitthreshold(const UniValue& params, bool fHelp)
     return int(pwalletMain->nStakeSplitThreshold);
 }
 
+UniValue simulatestaking(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "simulatestaking ( blocks )\n"
+            "\nReplays the wallet's kernel search against past tips of the active chain, without the network.\n"
+            "Every tip is searched the way the staker would from the moment it arrived, one hash slot after\n"
+            "another, until a kernel is found or the time of the next block is reached. Nothing is broadcast\n"
+            "or written to the wallet. The stake inputs are the ones the wallet has now.\n" +
+            HelpRequiringPassphrase() + "\n"
+
+            "\nArguments:\n"
+            "1. blocks   (numeric, optional, default=100) Number of past tips to replay\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"tips\": n,                    (numeric) Tips replayed\n"
+            "  \"inputs\": n,                  (numeric) Stake inputs selected from the wallet\n"
+            "  \"kernels\": n,                 (numeric) Tips a kernel was found on before the next block\n"
+            "  \"hashes\": n,                  (numeric) Kernel hashes computed\n"
+            "  \"hashespersec\": x.xxx,        (numeric) Kernel hashes per second while searching\n"
+            "  \"timetofirstkernel\": x.xxx,   (numeric) Average seconds from a tip to the kernel found on it\n"
+            "  \"timings\": {                  (json object) Milliseconds spent in each phase\n"
+            "    \"selection\": x.xxx,         (numeric) Selecting the stake inputs\n"
+            "    \"modifiers\": x.xxx,         (numeric) Looking up their stake modifiers\n"
+            "    \"hashing\": x.xxx,           (numeric) Searching for kernels\n"
+            "    \"signing\": x.xxx            (numeric) Building and signing coinstakes for the kernels found\n"
+            "  }\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("simulatestaking", "") + HelpExampleCli("simulatestaking", "1000") + HelpExampleRpc("simulatestaking", "1000"));
+
+    int nBlocks = params.size() > 0 ? params[0].get_int() : 100;
+    if (nBlocks < 1)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid number of blocks");
+
+    EnsureWalletIsUnlocked();
+
+    // Stake inputs with what their kernels need, and the height each one is at
+    std::list<std::unique_ptr<CStakeInput> > listInputs;
+    std::vector<CStakeInput*> vInputs;
+    std::vector<CStakeKernelCandidate> vCandidates;
+    std::vector<int> vHeightFrom;
+    // Past tips, each with the block that followed it
+    std::vector<std::pair<const CBlockIndex*, const CBlockIndex*> > vTips;
+    int64_t nSelectionTime, nModifierTime;
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+        int64_t nStart = GetTimeMicros();
+        CAmount nBalance = pwalletMain->GetBalance();
+        if (nBalance > nReserveBalance)
+            pwalletMain->SelectStakeCoins(listInputs, nBalance - nReserveBalance);
+        nSelectionTime = GetTimeMicros() - nStart;
+
+        nStart = GetTimeMicros();
+        for (std::unique_ptr<CStakeInput>& stakeInput : listInputs) {
+            CBlockIndex* pindex = stakeInput->GetIndexFrom();
+            uint64_t nStakeModifier = 0;
+            if (!pindex || !stakeInput->GetModifier(nStakeModifier))
+                continue;
+            vCandidates.push_back(CStakeKernelCandidate(stakeInput->GetUniqueness(), stakeInput->GetValue(), nStakeModifier, pindex->GetBlockTime()));
+            vHeightFrom.push_back(pindex->nHeight);
+            vInputs.push_back(stakeInput.get());
+        }
+        nModifierTime = GetTimeMicros() - nStart;
+
+        for (int nHeight = std::max(chainActive.Height() - nBlocks, 1); nHeight < chainActive.Height(); nHeight++)
+            vTips.push_back(std::make_pair(chainActive[nHeight], chainActive[nHeight + 1]));
+    }
+
+    uint64_t nHashes = 0;
+    int nKernels = 0;
+    int64_t nTimeToKernel = 0, nHashingTime = 0, nSigningTime = 0;
+    unsigned int nHashInterval = std::max(pwalletMain->nHashInterval, (unsigned int)1);
+    for (const std::pair<const CBlockIndex*, const CBlockIndex*>& tip : vTips) {
+        const CBlockIndex* pindexTip = tip.first;
+        const CBlockIndex* pindexNext = tip.second;
+
+        std::vector<CStakeKernelCandidate> vKernels;
+        std::vector<size_t> vKernelInputs;
+        for (size_t i = 0; i < vCandidates.size(); i++) {
+            if (vHeightFrom[i] < pindexTip->nHeight && vCandidates[i].nTimeBlockFrom + nStakeMinAge <= pindexTip->GetBlockTime()) {
+                vKernels.push_back(vCandidates[i]);
+                vKernelInputs.push_back(i);
+            }
+        }
+        if (vKernels.empty())
+            continue;
+
+        for (int64_t nSlotTime = pindexTip->GetBlockTime(); nSlotTime < pindexNext->GetBlockTime(); nSlotTime += nHashInterval) {
+            unsigned int nTimeTx = nSlotTime;
+            size_t nKernel = 0;
+            uint256 hashProofOfStake;
+            int64_t nStart = GetTimeMicros();
+            bool fFound = SearchStakeKernels(vKernels, pindexNext->nBits, nTimeTx, nKernel, hashProofOfStake, &nHashes);
+            nHashingTime += GetTimeMicros() - nStart;
+            if (!fFound)
+                continue;
+
+            nKernels++;
+            nTimeToKernel += nTimeTx - pindexTip->GetBlockTime();
+
+            // What CreateCoinStake does once it has a kernel, short of the block itself
+            CStakeInput* stakeInput = vInputs[vKernelInputs[nKernel]];
+            CTransaction txFrom;
+            if (!stakeInput->IsZARA() && stakeInput->GetTxFrom(txFrom)) {
+                nStart = GetTimeMicros();
+                CMutableTransaction txNew;
+                txNew.vout.push_back(CTxOut(0, CScript()));
+                std::vector<CTxOut> vout;
+                CTxIn in;
+                if (stakeInput->CreateTxOuts(pwalletMain, vout, stakeInput->GetValue()) && stakeInput->CreateTxIn(pwalletMain, in)) {
+                    txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
+                    txNew.vin.push_back(in);
+                    SignSignature(*pwalletMain, txFrom, txNew, 0);
+                }
+                nSigningTime += GetTimeMicros() - nStart;
+            }
+            break;
+        }
+    }
+
+    UniValue timings(UniValue::VOBJ);
+    timings.push_back(Pair("selection", nSelectionTime / 1000.0));
+    timings.push_back(Pair("modifiers", nModifierTime / 1000.0));
+    timings.push_back(Pair("hashing", nHashingTime / 1000.0));
+    timings.push_back(Pair("signing", nSigningTime / 1000.0));
+
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("tips", (int)vTips.size()));
+    result.push_back(Pair("inputs", (int)vInputs.size()));
+    result.push_back(Pair("kernels", nKernels));
+    result.push_back(Pair("hashes", (uint64_t)nHashes));
+    result.push_back(Pair("hashespersec", nHashingTime ? nHashes * 1000000.0 / nHashingTime : 0.0));
+    result.push_back(Pair("timetofirstkernel", nKernels ? (double)nTimeToKernel / nKernels : 0.0));
+    result.push_back(Pair("timings", timings));
+    return result;
+}
+
 UniValue autocombinerewards(const UniValue& params, bool fHelp)
 {
     bool fEnable;
@@ -12,6 +12,11 @@
 
 class CPubKey;
 
+/** -maxsigcachesize default, in megabytes */
+static const int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+/** Largest -maxsigcachesize accepted, in megabytes, so the table stays addressable with 32 bit indices */
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16384;
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
@@ -23,4 +28,7 @@ public:
     bool VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& vchPubKey, const uint256& sighash) const;
 };
 
+/** Size the signature cache according to -maxsigcachesize. Until this is called nothing is cached. */
+void InitSignatureCache();
+
 #endif // BITCOIN_SCRIPT_SIGCACHE_H
@@ -168,33 +168,51 @@ bool CZAraStake::MarkSpent(CWallet *pwallet, const uint256& txid)
 //!ARA Stake
 bool CAraStake::SetInput(CTransaction txPrev, unsigned int n)
 {
+    if (n >= txPrev.vout.size())
+        return false;
+
     this->txFrom = txPrev;
+    this->hashFrom = txPrev.GetHash();
     this->nPosition = n;
+    this->outFrom = txPrev.vout[n];
+    return true;
+}
+
+bool CAraStake::SetPrevout(const COutPoint& prevout, const CTxOut& out, CBlockIndex* pindex)
+{
+    this->txFrom = CTransaction();
+    this->hashFrom = prevout.hash;
+    this->nPosition = prevout.n;
+    this->outFrom = out;
+    this->pindexFrom = pindex;
     return true;
 }
 
 bool CAraStake::GetTxFrom(CTransaction& tx)
 {
+    if (txFrom.IsNull())
+        return false;
+
     tx = txFrom;
     return true;
 }
 
 bool CAraStake::CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut)
 {
-    txIn = CTxIn(txFrom.GetHash(), nPosition);
+    txIn = CTxIn(hashFrom, nPosition);
     return true;
 }
 
 CAmount CAraStake::GetValue()
 {
-    return txFrom.vout[nPosition].nValue;
+    return outFrom.nValue;
 }
 
 bool CAraStake::CreateTxOuts(CWallet* pwallet, vector<CTxOut>& vout, CAmount nTotal)
 {
     vector<valtype> vSolutions;
     txnouttype whichType;
-    CScript scriptPubKeyKernel = txFrom.vout[nPosition].scriptPubKey;
+    CScript scriptPubKeyKernel = outFrom.scriptPubKey;
     if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
         LogPrintf("CreateCoinStake : failed to parse kernel\n");
         return false;
@@ -243,16 +261,19 @@ CDataStream CAraStake::GetUniqueness()
 {
     //The unique identifier for a ARA stake is the outpoint
     CDataStream ss(SER_NETWORK, 0);
-    ss << nPosition << txFrom.GetHash();
+    ss << nPosition << hashFrom;
     return ss;
 }
 
 //The block that the UTXO was added to the chain
 CBlockIndex* CAraStake::GetIndexFrom()
 {
+    if (pindexFrom)
+        return pindexFrom;
+
     uint256 hashBlock = 0;
     CTransaction tx;
-    if (GetTransaction(txFrom.GetHash(), tx, hashBlock, true)) {
+    if (GetTransaction(hashFrom, tx, hashBlock, true)) {
         // If the index is in the chain, then set it as the "index from"
         if (mapBlockIndex.count(hashBlock)) {
             CBlockIndex* pindex = mapBlockIndex.at(hashBlock);
@@ -260,7 +281,7 @@ CBlockIndex* CAraStake::GetIndexFrom()
                 pindexFrom = pindex;
         }
     } else {
-        LogPrintf("%s : failed to find tx %s\n", __func__, txFrom.GetHash().GetHex());
+        LogPrintf("%s : failed to find tx %s\n", __func__, hashFrom.GetHex());
     }
 
     return pindexFrom;
@@ -67,8 +67,10 @@ public:
 class CAraStake : public CStakeInput
 {
 private:
-    CTransaction txFrom;
+    CTransaction txFrom; //! null when the input was set from the UTXO set
+    uint256 hashFrom;
     unsigned int nPosition;
+    CTxOut outFrom;
 public:
     CAraStake()
     {
@@ -76,6 +78,9 @@ public:
     }
 
     bool SetInput(CTransaction txPrev, unsigned int n);
+    //! Set the input from the output alone, for validation where the whole transaction is not needed
+    bool SetPrevout(const COutPoint& prevout, const CTxOut& out, CBlockIndex* pindex);
+    void SetIndexFrom(CBlockIndex* pindex) { pindexFrom = pindex; }
 
     CBlockIndex* GetIndexFrom() override;
     bool GetTxFrom(CTransaction& tx) override;
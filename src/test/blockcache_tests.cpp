@@ -0,0 +1,58 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+#include "serialize.h"
+#include "version.h"
+
+#include <boost/test/unit_test.hpp>
+
+static CBlockRef MakeTestBlock(uint32_t nNonce)
+{
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    pblock->nVersion = 1;
+    pblock->nNonce = nNonce;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nNonce;
+    pblock->vtx.push_back(CTransaction(tx));
+    return pblock;
+}
+
+BOOST_AUTO_TEST_SUITE(blockcache_tests)
+
+BOOST_AUTO_TEST_CASE(blockcache_lru_eviction)
+{
+    CBlockRef a = MakeTestBlock(1), b = MakeTestBlock(2), c = MakeTestBlock(3);
+    size_t nSize = ::GetSerializeSize(*a, SER_NETWORK, PROTOCOL_VERSION);
+    CBlockCache cache(nSize * 2);
+
+    cache.Insert(a);
+    cache.Insert(b);
+    BOOST_CHECK(cache.Get(a->GetHash()) == a);
+
+    // b is now the least recently used entry and makes room for c
+    cache.Insert(c);
+    BOOST_CHECK(cache.Get(a->GetHash()) == a);
+    BOOST_CHECK(!cache.Get(b->GetHash()));
+    BOOST_CHECK(cache.Get(c->GetHash()) == c);
+
+    CBlockCache::Stats stats = cache.GetStats();
+    BOOST_CHECK_EQUAL(stats.nBlocks, 2U);
+    BOOST_CHECK_EQUAL(stats.nBytes, nSize * 2);
+    BOOST_CHECK_EQUAL(stats.nHits, 3U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 1U);
+
+    // Re-inserting a block does not double count it
+    cache.Insert(c);
+    BOOST_CHECK_EQUAL(cache.GetStats().nBytes, nSize * 2);
+
+    cache.SetMaxSize(0);
+    BOOST_CHECK_EQUAL(cache.GetStats().nBlocks, 0U);
+    cache.Insert(a);
+    BOOST_CHECK(!cache.Get(a->GetHash()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,59 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockindexsnapshot.h"
+#include "main.h"
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockindexsnapshot_tests)
+
+BOOST_AUTO_TEST_CASE(blockindexsnapshot_roundtrip)
+{
+    LOCK(cs_main);
+    BOOST_REQUIRE(!mapBlockIndex.empty());
+    BOOST_REQUIRE(WriteBlockIndexSnapshot());
+
+    // Load into an empty map so the entries can be compared with the originals
+    BlockMap mapOriginal;
+    mapOriginal.swap(mapBlockIndex);
+    std::vector<std::pair<int, CBlockIndex*> > vSortedByHeight;
+    bool fLoaded = LoadBlockIndexSnapshot(vSortedByHeight);
+    BlockMap mapLoaded;
+    mapLoaded.swap(mapBlockIndex);
+    mapBlockIndex.swap(mapOriginal);
+
+    BOOST_CHECK(fLoaded);
+    BOOST_CHECK_EQUAL(mapLoaded.size(), mapBlockIndex.size());
+    BOOST_CHECK_EQUAL(vSortedByHeight.size(), mapLoaded.size());
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapLoaded) {
+        BlockMap::const_iterator mi = mapBlockIndex.find(item.first);
+        BOOST_REQUIRE(mi != mapBlockIndex.end());
+        const CBlockIndex* pindex = mi->second;
+        const CBlockIndex* pindexLoaded = item.second;
+        BOOST_CHECK(pindexLoaded->GetBlockHash() == item.first);
+        BOOST_CHECK(pindexLoaded->GetBlockHeader().GetHash() == item.first);
+        BOOST_CHECK_EQUAL(pindexLoaded->nHeight, pindex->nHeight);
+        BOOST_CHECK(pindexLoaded->nChainWork == pindex->nChainWork);
+        BOOST_CHECK_EQUAL(pindexLoaded->nChainTx, pindex->nChainTx);
+        BOOST_CHECK_EQUAL(pindexLoaded->nStatus, pindex->nStatus);
+        BOOST_CHECK_EQUAL(pindexLoaded->nMoneySupply, pindex->nMoneySupply);
+        BOOST_CHECK_EQUAL(pindexLoaded->pprev == NULL, pindex->pprev == NULL);
+        if (pindexLoaded->pprev)
+            BOOST_CHECK(pindexLoaded->pprev->GetBlockHash() == pindex->pprev->GetBlockHash());
+    }
+    for (const std::pair<const uint256, CBlockIndex*>& item : mapLoaded)
+        delete item.second;
+
+    // The snapshot is only good for one start
+    vSortedByHeight.clear();
+    mapOriginal.swap(mapBlockIndex);
+    fLoaded = LoadBlockIndexSnapshot(vSortedByHeight);
+    mapBlockIndex.swap(mapOriginal);
+    BOOST_CHECK(!fLoaded);
+    BOOST_CHECK(vSortedByHeight.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
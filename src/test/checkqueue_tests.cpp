@@ -0,0 +1,133 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "checkqueue.h"
+
+#include <atomic>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+namespace {
+struct CCountingCheck {
+    std::atomic<int>* pcount;
+    bool fResult;
+
+    CCountingCheck() : pcount(NULL), fResult(true) {}
+    CCountingCheck(std::atomic<int>* pcountIn, bool fResultIn) : pcount(pcountIn), fResult(fResultIn) {}
+
+    bool operator()()
+    {
+        ++*pcount;
+        return fResult;
+    }
+
+    void swap(CCountingCheck& check)
+    {
+        std::swap(pcount, check.pcount);
+        std::swap(fResult, check.fResult);
+    }
+};
+
+class CWorkerThreads
+{
+public:
+    boost::thread_group threads;
+
+    CWorkerThreads(CCheckQueue& queue, int nThreads)
+    {
+        for (int i = 0; i < nThreads; i++)
+            threads.create_thread(boost::bind(&CCheckQueue::Thread, &queue));
+    }
+
+    ~CWorkerThreads()
+    {
+        threads.interrupt_all();
+        threads.join_all();
+    }
+};
+} // anon namespace
+
+BOOST_AUTO_TEST_SUITE(checkqueue_tests)
+
+BOOST_AUTO_TEST_CASE(checkqueue_no_queue)
+{
+    // Without a queue, vectors of checks are dropped and single jobs run inline
+    std::atomic<int> nRun(0);
+    CCheckQueueControl control(NULL);
+    std::vector<CCountingCheck> vChecks(10, CCountingCheck(&nRun, false));
+    control.Add(vChecks);
+    BOOST_CHECK_EQUAL(nRun, 0);
+    control.Add([&nRun]() { return ++nRun > 0; });
+    BOOST_CHECK_EQUAL(nRun, 1);
+    BOOST_CHECK(control.Wait());
+
+    CCheckQueueControl controlFail(NULL);
+    controlFail.Add([]() { return false; });
+    BOOST_CHECK(!controlFail.Wait());
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_mixed_jobs)
+{
+    CCheckQueue queue(4);
+    CWorkerThreads workers(queue, 4);
+
+    for (int nRound = 0; nRound < 20; nRound++) {
+        std::atomic<int> nRun(0);
+        CCheckQueueControl control(&queue);
+        std::vector<CCountingCheck> vChecks(100, CCountingCheck(&nRun, true));
+        control.Add(vChecks);
+        for (int i = 0; i < 10; i++)
+            control.Add([&nRun]() { ++nRun; return true; });
+        BOOST_CHECK(control.Wait());
+        BOOST_CHECK_EQUAL(nRun, 110);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_failure)
+{
+    CCheckQueue queue(4);
+    CWorkerThreads workers(queue, 4);
+
+    std::atomic<int> nRun(0);
+    CCheckQueueControl control(&queue);
+    std::vector<CCountingCheck> vChecks(1000, CCountingCheck(&nRun, true));
+    vChecks[500].fResult = false;
+    control.Add(vChecks);
+    BOOST_CHECK(!control.Wait());
+    // Checks after the failure may have been skipped, but none ran twice
+    BOOST_CHECK(nRun <= 1000);
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_concurrent_controls)
+{
+    // Two controls sharing the pool each see only their own results
+    CCheckQueue queue(4);
+    CWorkerThreads workers(queue, 2);
+
+    std::atomic<int> nRunGood(0), nRunBad(0);
+    bool fGood = false, fBad = true;
+    boost::thread threadGood([&]() {
+        CCheckQueueControl control(&queue);
+        std::vector<CCountingCheck> vChecks(500, CCountingCheck(&nRunGood, true));
+        control.Add(vChecks);
+        fGood = control.Wait();
+    });
+    boost::thread threadBad([&]() {
+        CCheckQueueControl control(&queue);
+        std::vector<CCountingCheck> vChecks(500, CCountingCheck(&nRunBad, true));
+        vChecks[0].fResult = false;
+        control.Add(vChecks);
+        fBad = control.Wait();
+    });
+    threadGood.join();
+    threadBad.join();
+    BOOST_CHECK(fGood);
+    BOOST_CHECK(!fBad);
+    BOOST_CHECK_EQUAL(nRunGood, 500);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include "coins.h"
 #include "random.h"
+#include "txdb.h"
 #include "uint256.h"
 
 #include <vector>
@@ -175,4 +176,130 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(missed_an_entry);
 }
 
+static CMutableTransaction CreateCoinsTestTx(unsigned int nOutputs)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    tx.vout.resize(nOutputs);
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        tx.vout[i].nValue = (i + 1) * COIN;
+        tx.vout[i].scriptPubKey = CScript() << OP_TRUE;
+    }
+    return tx;
+}
+
+// Only the outputs whose spentness changed are reported as dirty to the parent view.
+BOOST_AUTO_TEST_CASE(coins_dirty_outputs_test)
+{
+    class CCoinsViewRecorder : public CCoinsViewTest
+    {
+    public:
+        CCoinsMap mapWritten;
+
+        bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+        {
+            mapWritten = mapCoins;
+            return CCoinsViewTest::BatchWrite(mapCoins, hashBlock);
+        }
+    };
+
+    CMutableTransaction tx = CreateCoinsTestTx(4);
+    const uint256 txid = CTransaction(tx).GetHash();
+
+    CCoinsViewRecorder base;
+    {
+        CCoinsViewCache cache(&base);
+        cache.ModifyCoins(txid)->FromTx(tx, 1);
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(base.mapWritten[txid].flags & CCoinsCacheEntry::FRESH);
+
+    CCoinsViewCache cache(&base);
+    CCoinsViewCache child(&cache);
+    BOOST_CHECK(child.ModifyCoins(txid)->Spend(2));
+    BOOST_CHECK(child.Flush());
+    BOOST_CHECK(cache.Flush());
+
+    const CCoinsCacheEntry& entry = base.mapWritten[txid];
+    BOOST_CHECK(entry.flags & CCoinsCacheEntry::DIRTY);
+    BOOST_CHECK(!(entry.flags & CCoinsCacheEntry::FRESH));
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+        BOOST_CHECK_EQUAL(entry.IsOutputDirty(i), i == 2);
+}
+
+// Per-output records in the coin database round trip through partial and full spends.
+BOOST_AUTO_TEST_CASE(coins_db_per_output_test)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    CMutableTransaction tx = CreateCoinsTestTx(3);
+    const uint256 txid = CTransaction(tx).GetHash();
+
+    {
+        CCoinsViewCache cache(&db);
+        cache.ModifyCoins(txid)->FromTx(tx, 100);
+        cache.SetBestBlock(GetRandHash());
+        BOOST_CHECK(cache.Flush());
+    }
+    CCoins coins;
+    BOOST_CHECK(db.HaveCoins(txid));
+    BOOST_CHECK(!db.HaveCoins(GetRandHash()));
+    BOOST_CHECK(db.GetCoins(txid, coins));
+    BOOST_CHECK(coins == CCoins(tx, 100));
+
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(1));
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(db.GetCoins(txid, coins));
+    BOOST_CHECK(coins.IsAvailable(0));
+    BOOST_CHECK(!coins.IsAvailable(1));
+    BOOST_CHECK(coins.IsAvailable(2));
+    BOOST_CHECK_EQUAL(coins.nHeight, 100);
+
+    {
+        CCoinsViewCache cache(&db);
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(0));
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(2));
+        BOOST_CHECK(cache.Flush());
+    }
+    BOOST_CHECK(!db.HaveCoins(txid));
+    BOOST_CHECK(!db.GetCoins(txid, coins));
+}
+
+// Entries handed to the background writer stay visible until they reach the database.
+BOOST_AUTO_TEST_CASE(coins_db_async_test)
+{
+    CCoinsViewDB db(1 << 20, true, true);
+    CMutableTransaction tx = CreateCoinsTestTx(2);
+    const uint256 txid = CTransaction(tx).GetHash();
+    const uint256 hashBlock = GetRandHash();
+
+    {
+        CCoinsViewDBAsync async(&db);
+        CCoinsViewCache cache(&async);
+        cache.ModifyCoins(txid)->FromTx(tx, 10);
+        cache.SetBestBlock(hashBlock);
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(cache.HaveCoins(txid));
+        BOOST_CHECK(async.GetBestBlock() == hashBlock);
+
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(0));
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(async.Sync());
+
+        CCoins coins;
+        BOOST_CHECK(db.GetCoins(txid, coins));
+        BOOST_CHECK(!coins.IsAvailable(0));
+        BOOST_CHECK(coins.IsAvailable(1));
+
+        BOOST_CHECK(cache.ModifyCoins(txid)->Spend(1));
+        BOOST_CHECK(cache.Flush());
+    }
+    // Destroying the writer completes the queued batch
+    BOOST_CHECK(!db.HaveCoins(txid));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,66 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+#include "random.h"
+#include "uint256.h"
+
+#include <cstring>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+class RandomHashHasher
+{
+public:
+    template <uint8_t hash_select>
+    uint32_t operator()(const uint256& key) const
+    {
+        uint32_t u;
+        std::memcpy(&u, key.begin() + 4 * hash_select, 4);
+        return u;
+    }
+};
+} // anon namespace
+
+BOOST_AUTO_TEST_SUITE(cuckoocache_tests)
+
+BOOST_AUTO_TEST_CASE(cuckoocache_insert_contains_erase)
+{
+    CuckooCache::cache<uint256, RandomHashHasher> cache;
+    BOOST_CHECK(!cache.contains(GetRandHash(), false));
+
+    uint32_t nSlots = cache.setup_bytes(1 << 16);
+    BOOST_CHECK_EQUAL(nSlots, (1 << 16) / sizeof(uint256));
+
+    // Half full: everything inserted is found
+    std::vector<uint256> vHashes;
+    for (uint32_t i = 0; i < nSlots / 2; i++) {
+        vHashes.push_back(GetRandHash());
+        cache.insert(vHashes.back());
+    }
+    for (const uint256& hash : vHashes)
+        BOOST_CHECK(cache.contains(hash, false));
+    BOOST_CHECK(!cache.contains(GetRandHash(), false));
+
+    // A lookup that erases finds the element once
+    BOOST_CHECK(cache.contains(vHashes[0], true));
+    BOOST_CHECK(!cache.contains(vHashes[0], false));
+    cache.insert(vHashes[0]);
+    BOOST_CHECK(cache.contains(vHashes[0], false));
+
+    // Overfilling drops elements but keeps most of the recent ones
+    std::vector<uint256> vRecent;
+    for (uint32_t i = 0; i < nSlots * 2; i++) {
+        vRecent.push_back(GetRandHash());
+        cache.insert(vRecent.back());
+    }
+    uint32_t nFound = 0;
+    for (uint32_t i = vRecent.size() - nSlots / 4; i < vRecent.size(); i++)
+        nFound += cache.contains(vRecent[i], false);
+    BOOST_CHECK(nFound > nSlots / 8);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
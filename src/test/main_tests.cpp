@@ -6,7 +6,9 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "primitives/transaction.h"
+#include "clientversion.h"
 #include "main.h"
+#include "streams.h"
 
 #include <boost/test/unit_test.hpp>
 
@@ -49,4 +51,48 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK(nSum == 4109975100000000ULL);
 }
 
+BOOST_AUTO_TEST_CASE(read_raw_block_test)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindex = chainActive.Genesis();
+    BOOST_REQUIRE(pindex != NULL);
+
+    CDataStream ssExpected(SER_NETWORK, PROTOCOL_VERSION);
+    ssExpected << Params().GenesisBlock();
+
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(ReadRawBlockFromDisk(ssBlock, pindex->GetBlockPos(), pindex->GetBlockHash()));
+    BOOST_CHECK(ssBlock.str() == ssExpected.str());
+
+    // A position that does not hold the requested block is rejected
+    BOOST_CHECK(!ReadRawBlockFromDisk(ssBlock, pindex->GetBlockPos(), uint256(1)));
+}
+
+BOOST_AUTO_TEST_CASE(load_external_block_file_test)
+{
+    CDataStream ssGenesis(SER_DISK, CLIENT_VERSION);
+    ssGenesis << Params().GenesisBlock();
+    unsigned int nSize = ssGenesis.size();
+
+    // Garbage, a valid record, a record that does not deserialize and another valid record
+    FILE* file = tmpfile();
+    BOOST_REQUIRE(file != NULL);
+    {
+        CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+        fileout << std::vector<unsigned char>(100, 0x55);
+        fileout << FLATDATA(Params().MessageStart()) << nSize;
+        fileout.write(&ssGenesis[0], nSize);
+        fileout << FLATDATA(Params().MessageStart()) << nSize;
+        fileout.write(&ssGenesis[0], 80);
+        fileout << std::vector<unsigned char>(nSize - 80, 0xff);
+        fileout << FLATDATA(Params().MessageStart()) << nSize;
+        fileout.write(&ssGenesis[0], nSize);
+        fileout.release();
+    }
+    rewind(file);
+
+    // Every record is known already, the import has to get through the file without connecting anything
+    BOOST_CHECK(!LoadExternalBlockFile(file));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,61 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "clientversion.h"
+#include "mappedfile.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(mappedfile_tests)
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(mappedfile_read_and_remap)
+{
+    boost::filesystem::path path = GetTempPath() / strprintf("test_mappedfile_%i", (int)GetRand(100000));
+    {
+        CAutoFile fileout(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        fileout << (uint32_t)1234 << std::string("mapped");
+    }
+
+    CMappedFileCache cache(2);
+    CMappedFileRef pfile = cache.Get(path, 4);
+    BOOST_REQUIRE(pfile);
+    BOOST_CHECK(cache.Get(path, 4) == pfile);
+
+    uint32_t n;
+    std::string str;
+    CMemoryReader reader(pfile->begin(), pfile->end(), SER_DISK, CLIENT_VERSION);
+    reader >> n >> str;
+    BOOST_CHECK_EQUAL(n, 1234U);
+    BOOST_CHECK_EQUAL(str, "mapped");
+    BOOST_CHECK(reader.empty());
+    BOOST_CHECK_THROW(reader >> n, std::ios_base::failure);
+
+    // Asking for more than the file holds fails until the file has grown
+    size_t nOldSize = pfile->size();
+    BOOST_CHECK(!cache.Get(path, nOldSize + 4));
+    {
+        CAutoFile fileout(fopen(path.string().c_str(), "ab"), SER_DISK, CLIENT_VERSION);
+        fileout << (uint32_t)5678;
+    }
+    CMappedFileRef pfileNew = cache.Get(path, nOldSize + 4);
+    BOOST_REQUIRE(pfileNew);
+    BOOST_CHECK(pfileNew != pfile);
+    CMemoryReader readerNew(pfileNew->begin() + nOldSize, pfileNew->end(), SER_DISK, CLIENT_VERSION);
+    readerNew >> n;
+    BOOST_CHECK_EQUAL(n, 5678U);
+
+    // The old mapping stays usable while it is referenced
+    BOOST_CHECK_EQUAL(pfile->size(), nOldSize);
+
+    cache.Clear();
+    boost::filesystem::remove(path);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -99,4 +99,107 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+BOOST_AUTO_TEST_CASE(MempoolPackageStateTest)
+{
+    // A chain parent -> child -> grandchild, each paying a different fee
+    CTxMemPool pool(CFeeRate(0));
+    CMutableTransaction tx[3];
+    for (int i = 0; i < 3; i++) {
+        tx[i].vin.resize(1);
+        tx[i].vin[0].scriptSig = CScript() << OP_11;
+        tx[i].vin[0].prevout = i == 0 ? COutPoint(uint256(1), 0) : COutPoint(tx[i - 1].GetHash(), 0);
+        tx[i].vout.resize(1);
+        tx[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx[i].vout[0].nValue = 10 * COIN;
+        pool.addUnchecked(tx[i].GetHash(), CTxMemPoolEntry(tx[i], 1000 * (i + 1), 0, 0.0, 1));
+    }
+    CTxMemPool::txiter it[3];
+    size_t nSize = 0;
+    for (int i = 0; i < 3; i++) {
+        it[i] = pool.mapTx.find(tx[i].GetHash());
+        nSize += it[i]->GetTxSize();
+    }
+
+    BOOST_CHECK_EQUAL(it[0]->GetCountWithDescendants(), 3);
+    BOOST_CHECK_EQUAL(it[0]->GetFeesWithDescendants(), 6000);
+    BOOST_CHECK_EQUAL(it[0]->GetSizeWithDescendants(), nSize);
+    BOOST_CHECK_EQUAL(it[1]->GetCountWithDescendants(), 2);
+    BOOST_CHECK_EQUAL(it[2]->GetCountWithAncestors(), 3);
+    BOOST_CHECK_EQUAL(it[2]->GetFeesWithAncestors(), 6000);
+    BOOST_CHECK_EQUAL(it[2]->GetSizeWithAncestors(), nSize);
+
+    // Limits are enforced on the whole package
+    CMutableTransaction txNext;
+    txNext.vin.resize(1);
+    txNext.vin[0].scriptSig = CScript() << OP_11;
+    txNext.vin[0].prevout = COutPoint(tx[2].GetHash(), 0);
+    txNext.vout.resize(1);
+    txNext.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txNext.vout[0].nValue = 10 * COIN;
+    CTxMemPoolEntry entryNext(txNext, 1000, 0, 0.0, 1);
+    CTxMemPool::setEntries setAncestors;
+    std::string errString;
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(entryNext, setAncestors, 3, 1000000, 25, 1000000, errString));
+    setAncestors.clear();
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(entryNext, setAncestors, 4, 1000000, 25, 1000000, errString));
+    BOOST_CHECK_EQUAL(setAncestors.size(), 3);
+
+    // Confirming the parent leaves the rest with updated ancestor state
+    std::list<CTransaction> removed;
+    pool.remove(tx[0], removed, false);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    it[2] = pool.mapTx.find(tx[2].GetHash());
+    BOOST_CHECK_EQUAL(it[2]->GetCountWithAncestors(), 2);
+    BOOST_CHECK_EQUAL(it[2]->GetFeesWithAncestors(), 5000);
+    BOOST_CHECK_EQUAL(pool.mapTx.find(tx[1].GetHash())->GetCountWithDescendants(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+
+    // Three independent transactions; the cheapest one per byte goes first
+    CMutableTransaction tx[3];
+    CAmount nFees[3] = {15000, 1000, 5000};
+    for (int i = 0; i < 3; i++) {
+        tx[i].vin.resize(1);
+        tx[i].vin[0].scriptSig = CScript() << OP_11;
+        tx[i].vin[0].prevout = COutPoint(uint256(i + 1), 0);
+        tx[i].vout.resize(1);
+        tx[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx[i].vout[0].nValue = 10 * COIN;
+        pool.addUnchecked(tx[i].GetHash(), CTxMemPoolEntry(tx[i], nFees[i], i, 0.0, 1));
+    }
+    // A child lifts the package of tx[1] above tx[2]
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout = COutPoint(tx[1].GetHash(), 0);
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 10 * COIN;
+    pool.addUnchecked(txChild.GetHash(), CTxMemPoolEntry(txChild, 20000, 3, 0.0, 1));
+
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), 0);
+    size_t nUsage = pool.DynamicMemoryUsage();
+    pool.TrimToSize(nUsage);
+    BOOST_CHECK_EQUAL(pool.size(), 4);
+
+    // Evicts tx[2], the lowest feerate package, and raises the minimum fee above it
+    pool.TrimToSize(nUsage - 1);
+    BOOST_CHECK(!pool.exists(tx[2].GetHash()));
+    BOOST_CHECK(pool.exists(tx[1].GetHash()) && pool.exists(txChild.GetHash()));
+    size_t nSize2 = ::GetSerializeSize(tx[2], SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK_EQUAL(pool.GetMinFee(1).GetFeePerK(), CFeeRate(5000, nSize2).GetFeePerK() + 1000);
+
+    // Evicting tx[1] takes its child along
+    pool.TrimToSize(pool.DynamicMemoryUsage() - 1);
+    BOOST_CHECK_EQUAL(pool.size(), 1);
+    BOOST_CHECK(pool.exists(tx[0].GetHash()));
+
+    // Expiry removes what entered before the given time
+    BOOST_CHECK_EQUAL(pool.Expire(1), 1);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
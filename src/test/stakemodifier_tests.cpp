@@ -0,0 +1,110 @@
+// Copyright (c) 2019 The Aratriton developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "kernel.h"
+#include "main.h"
+#include "random.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(stakemodifier_tests)
+
+// Build a chain on top of pindexFork (or from height 0 if it is NULL) whose
+// block times jitter around a 60 second spacing, so they are not monotonic
+static void BuildChain(std::vector<CBlockIndex>& vIndex, std::vector<uint256>& vHashes, CBlockIndex* pindexFork)
+{
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        CBlockIndex& index = vIndex[i];
+        vHashes[i] = GetRandHash();
+        index.phashBlock = &vHashes[i];
+        index.pprev = i ? &vIndex[i - 1] : pindexFork;
+        index.nHeight = index.pprev ? index.pprev->nHeight + 1 : 0;
+        index.nTime = 1500000000 + index.nHeight * 60 + insecure_rand() % 120;
+        index.SetStakeModifier(((uint64_t)insecure_rand() << 32) | insecure_rand(), insecure_rand() % 3 == 0);
+        index.BuildSkip();
+        mapBlockIndex.insert(std::make_pair(vHashes[i], &index));
+    }
+}
+
+// The forward walk along chainActive the index replaces
+static bool WalkStakeModifier(const CBlockIndex* pindexFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime)
+{
+    int64_t nSelectionInterval = 0;
+    for (int nSection = 0; nSection < 64; nSection++)
+        nSelectionInterval += getIntervalVersion(false) * 63 / (63 + ((63 - nSection) * (MODIFIER_INTERVAL_RATIO - 1)));
+
+    nStakeModifierHeight = pindexFrom->nHeight;
+    nStakeModifierTime = pindexFrom->GetBlockTime();
+    const CBlockIndex* pindex = pindexFrom;
+    while (nStakeModifierTime < pindexFrom->GetBlockTime() + nSelectionInterval) {
+        pindex = chainActive[pindex->nHeight + 1];
+        if (!pindex)
+            return false;
+        if (pindex->GeneratedStakeModifier()) {
+            nStakeModifierHeight = pindex->nHeight;
+            nStakeModifierTime = pindex->GetBlockTime();
+        }
+    }
+    nStakeModifier = pindex->nStakeModifier;
+    return true;
+}
+
+static void CheckAgainstWalk(const std::vector<CBlockIndex*>& vFrom)
+{
+    for (const CBlockIndex* pindexFrom : vFrom) {
+        uint64_t nModifier = 0, nModifierWalk = 0;
+        int nHeight = 0, nHeightWalk = 0;
+        int64_t nTime = 0, nTimeWalk = 0;
+        bool fFound = GetKernelStakeModifier(pindexFrom->GetBlockHash(), nModifier, nHeight, nTime, false);
+        bool fFoundWalk = WalkStakeModifier(pindexFrom, nModifierWalk, nHeightWalk, nTimeWalk);
+        BOOST_CHECK_EQUAL(fFound, fFoundWalk);
+        if (fFound && fFoundWalk) {
+            BOOST_CHECK_EQUAL(nModifier, nModifierWalk);
+            BOOST_CHECK_EQUAL(nHeight, nHeightWalk);
+            BOOST_CHECK_EQUAL(nTime, nTimeWalk);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(stakemodifier_index_matches_walk)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindexOriginalTip = chainActive.Tip();
+
+    std::vector<CBlockIndex> vMain(600);
+    std::vector<uint256> vMainHashes(vMain.size());
+    BuildChain(vMain, vMainHashes, NULL);
+    chainActive.SetTip(&vMain.back());
+    UpdateStakeModifierIndex();
+
+    std::vector<CBlockIndex*> vFrom;
+    for (CBlockIndex& index : vMain)
+        vFrom.push_back(&index);
+    CheckAgainstWalk(vFrom);
+
+    // Reorganize onto a branch forking off at height 400, then extend it block by block
+    std::vector<CBlockIndex> vBranch(300);
+    std::vector<uint256> vBranchHashes(vBranch.size());
+    BuildChain(vBranch, vBranchHashes, &vMain[400]);
+    for (size_t i = 0; i < vBranch.size(); i += 50) {
+        chainActive.SetTip(&vBranch[i]);
+        UpdateStakeModifierIndex();
+    }
+    chainActive.SetTip(&vBranch.back());
+    for (CBlockIndex& index : vBranch)
+        vFrom.push_back(&index);
+    CheckAgainstWalk(vFrom);
+
+    // Back to the original chain, without leaving anything behind
+    chainActive.SetTip(pindexOriginalTip);
+    UpdateStakeModifierIndex();
+    for (const uint256& hash : vMainHashes)
+        mapBlockIndex.erase(hash);
+    for (const uint256& hash : vBranchHashes)
+        mapBlockIndex.erase(hash);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -34,6 +34,7 @@ struct TestingSetup {
 
     TestingSetup() {
         ECC_Start();
+        InitSignatureCache();
         SetupEnvironment();
         fPrintToDebugLog = false; // don't want to write to debug.log file
         fCheckBlockIndex = true;
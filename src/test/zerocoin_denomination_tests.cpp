@@ -520,4 +520,41 @@ BOOST_AUTO_TEST_CASE(zerocoin_spend_test99)
     nValueTarget += OneCoinAmount;
 }
 
+BOOST_AUTO_TEST_CASE(blockindex_denomination_serialization_test)
+{
+    uint256 hash = 1;
+    CBlockIndex index;
+    index.phashBlock = &hash;
+    index.nVersion = 4;
+    index.SetZerocoinSupply(ZQ_ONE, 12);
+    index.SetZerocoinSupply(ZQ_FIVE_THOUSAND, 3);
+    index.AddMint(ZQ_TEN);
+    index.AddMint(ZQ_ONE);
+    index.AddMint(ZQ_TEN);
+    BOOST_CHECK_EQUAL(index.GetMintCount(ZQ_TEN), 2);
+    BOOST_CHECK(index.MintedDenomination(ZQ_ONE));
+    BOOST_CHECK(!index.MintedDenomination(ZQ_FIFTY));
+    BOOST_CHECK_EQUAL(index.GetZerocoinSupply(), 12 * COIN + 3 * 5000 * COIN);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << CDiskBlockIndex(&index);
+
+    // The compact in-memory fields are stored as the map of supplies and the list of mints
+    std::map<CoinDenomination, int64_t> mapSupply;
+    for (auto& denom : zerocoinDenomList)
+        mapSupply[denom] = index.GetZerocoinSupply(denom);
+    std::vector<CoinDenomination> vMints = {ZQ_ONE, ZQ_TEN, ZQ_TEN};
+    CDataStream ssTail(SER_DISK, CLIENT_VERSION);
+    ssTail << mapSupply << vMints;
+    BOOST_REQUIRE(ss.size() > ssTail.size());
+    BOOST_CHECK(ss.str().substr(ss.size() - ssTail.size()) == ssTail.str());
+
+    CDiskBlockIndex diskindex;
+    ss >> diskindex;
+    for (auto& denom : zerocoinDenomList) {
+        BOOST_CHECK_EQUAL(diskindex.GetZerocoinSupply(denom), index.GetZerocoinSupply(denom));
+        BOOST_CHECK_EQUAL(diskindex.GetMintCount(denom), index.GetMintCount(denom));
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
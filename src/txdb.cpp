@@ -8,22 +8,145 @@
 
 #include "main.h"
 #include "pow.h"
+#include "ui_interface.h"
 #include "uint256.h"
 #include "accumulators.h"
 
+#include <algorithm>
 #include <stdint.h>
 
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
 using namespace libzerocoin;
 
-void static BatchWriteCoins(CLevelDBBatch& batch, const uint256& hash, const CCoins& coins)
+/** Prefix of the legacy per-transaction CCoins records in the coin database */
+static const char DB_COINS = 'c';
+/** Prefix of the per-output records in the coin database */
+static const char DB_COIN_OUTPUT = 'C';
+
+/**
+ * Key of a per-output coin database record: the txid followed by the output index.
+ * All outputs of one transaction are adjacent, so they can be read with a single seek.
+ */
+struct CCoinsOutputKey {
+    char chType;
+    uint256 txid;
+    uint32_t n;
+
+    CCoinsOutputKey() : chType(DB_COIN_OUTPUT), txid(0), n(0) {}
+    CCoinsOutputKey(const uint256& txidIn, uint32_t nIn) : chType(DB_COIN_OUTPUT), txid(txidIn), n(nIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(chType);
+        READWRITE(txid);
+        READWRITE(VARINT(n));
+    }
+};
+
+/**
+ * Value of a per-output coin database record.
+ *
+ * Serialized format:
+ * - VARINT(nVersion)
+ * - VARINT(nHeight * 4 + fCoinStake * 2 + fCoinBase)
+ * - the unspent CTxOut (via CTxOutCompressor)
+ */
+class CCoinsOutputRecord
+{
+public:
+    CTxOut txout;
+    bool fCoinBase;
+    bool fCoinStake;
+    int nHeight;
+    int nVersion;
+
+    CCoinsOutputRecord() : txout(), fCoinBase(false), fCoinStake(false), nHeight(0), nVersion(0) {}
+    CCoinsOutputRecord(const CCoins& coins, unsigned int nPos) : txout(coins.vout[nPos]), fCoinBase(coins.fCoinBase), fCoinStake(coins.fCoinStake), nHeight(coins.nHeight), nVersion(coins.nVersion) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        uint64_t nCode = (uint64_t)nHeight * 4 + (fCoinStake ? 2 : 0) + (fCoinBase ? 1 : 0);
+        READWRITE(VARINT(this->nVersion));
+        READWRITE(VARINT(nCode));
+        if (ser_action.ForRead()) {
+            nHeight = nCode >> 2;
+            fCoinStake = (nCode & 2) != 0;
+            fCoinBase = (nCode & 1) != 0;
+        }
+        READWRITE(REF(CTxOutCompressor(REF(txout))));
+    }
+
+    //! apply this output and its transaction metadata to coins
+    void ApplyTo(CCoins& coins, unsigned int nPos) const
+    {
+        coins.fCoinBase = fCoinBase;
+        coins.fCoinStake = fCoinStake;
+        coins.nHeight = nHeight;
+        coins.nVersion = nVersion;
+        if (coins.vout.size() <= nPos)
+            coins.vout.resize(nPos + 1);
+        coins.vout[nPos] = txout;
+    }
+};
+
+/** Write the outputs of an entry that changed since it was read from the database */
+void static BatchWriteCoins(CLevelDBBatch& batch, const uint256& hash, const CCoinsCacheEntry& entry)
+{
+    const CCoins& coins = entry.coins;
+    bool fFresh = (entry.flags & CCoinsCacheEntry::FRESH) != 0;
+    unsigned int nOutputs = std::max((unsigned int)coins.vout.size(), (unsigned int)entry.vDirtyOutputs.size());
+    for (unsigned int i = 0; i < nOutputs; i++) {
+        bool fAvailable = i < coins.vout.size() && !coins.vout[i].IsNull();
+        // A fresh entry has no records in the database yet, so every unspent output is written
+        if (!entry.IsOutputDirty(i) && !(fFresh && fAvailable))
+            continue;
+        if (fAvailable)
+            batch.Write(CCoinsOutputKey(hash, i), CCoinsOutputRecord(coins, i));
+        else if (!fFresh)
+            batch.Erase(CCoinsOutputKey(hash, i));
+    }
+}
+
+/**
+ * Read all per-output records of the transaction the cursor is positioned at,
+ * leaving the cursor at the first record after them. If fRequireTxid is set,
+ * only records of txid are accepted; otherwise txid is set to the transaction read.
+ * Returns false if no output was found.
+ */
+bool static ReadCoinsAtCursor(leveldb::Iterator* pcursor, uint256& txid, bool fRequireTxid, CCoins& coins, size_t& nSerializedSize)
 {
-    if (coins.IsPruned())
-        batch.Erase(make_pair('c', hash));
-    else
-        batch.Write(make_pair('c', hash), coins);
+    coins.Clear();
+    nSerializedSize = 0;
+    bool fFound = false;
+    while (pcursor->Valid()) {
+        leveldb::Slice slKey = pcursor->key();
+        if (slKey.size() == 0 || slKey[0] != DB_COIN_OUTPUT)
+            break;
+        CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+        CCoinsOutputKey key;
+        ssKey >> key;
+        if ((fFound || fRequireTxid) && key.txid != txid)
+            break;
+        leveldb::Slice slValue = pcursor->value();
+        CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+        CCoinsOutputRecord record;
+        ssValue >> record;
+        record.ApplyTo(coins, key.n);
+        nSerializedSize += slKey.size() + slValue.size();
+        txid = key.txid;
+        fFound = true;
+        pcursor->Next();
+    }
+    return fFound;
 }
 
 void static BatchWriteHashBestChain(CLevelDBBatch& batch, const uint256& hash)
@@ -37,12 +160,35 @@ CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(Get
 
 bool CCoinsViewDB::GetCoins(const uint256& txid, CCoins& coins) const
 {
-    return db.Read(make_pair('c', txid), coins);
+    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << CCoinsOutputKey(txid, 0);
+    pcursor->Seek(ssKeySet.str());
+
+    uint256 txidFound = txid;
+    size_t nSize;
+    try {
+        if (!ReadCoinsAtCursor(pcursor.get(), txidFound, true, coins, nSize))
+            return false;
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256& txid) const
 {
-    return db.Exists(make_pair('c', txid));
+    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << CCoinsOutputKey(txid, 0);
+    pcursor->Seek(ssKeySet.str());
+    if (!pcursor->Valid())
+        return false;
+
+    // Every output key starts with the same type byte and txid
+    leveldb::Slice slKey = pcursor->key();
+    size_t nPrefix = 1 + sizeof(uint256);
+    return slKey.size() > nPrefix && memcmp(slKey.data(), &ssKeySet[0], nPrefix) == 0;
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const
@@ -54,18 +200,23 @@ uint256 CCoinsViewDB::GetBestBlock() const
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    bool fOk = WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return fOk;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap& mapCoins, const uint256& hashBlock)
 {
     CLevelDBBatch batch;
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            BatchWriteCoins(batch, it->first, it->second.coins);
+            BatchWriteCoins(batch, it->first, it->second);
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
     if (hashBlock != uint256(0))
         BatchWriteHashBestChain(batch, hashBlock);
@@ -74,6 +225,188 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
     return db.WriteBatch(batch);
 }
 
+bool CCoinsViewDB::Upgrade()
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(db.NewIterator());
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair(DB_COINS, uint256(0));
+    pcursor->Seek(ssKeySet.str());
+    if (!pcursor->Valid() || pcursor->key().size() == 0 || pcursor->key()[0] != DB_COINS)
+        return true;
+
+    LogPrintf("Upgrading coin database to per-output records...\n");
+    uiInterface.InitMessage(_("Upgrading coin database..."));
+
+    static const size_t nBatchSize = 16 << 20;
+    size_t nTransactions = 0;
+    size_t nOutputs = 0;
+    CLevelDBBatch batch;
+    size_t nBatchBytes = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != DB_COINS)
+                break;
+            uint256 txid;
+            ssKey >> txid;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CCoins coins;
+            ssValue >> coins;
+            for (unsigned int i = 0; i < coins.vout.size(); i++) {
+                if (coins.vout[i].IsNull())
+                    continue;
+                batch.Write(CCoinsOutputKey(txid, i), CCoinsOutputRecord(coins, i));
+                nOutputs++;
+            }
+            batch.Erase(make_pair(DB_COINS, txid));
+            nBatchBytes += slKey.size() + 2 * slValue.size();
+            nTransactions++;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+
+        // Records are erased as they are converted, so an interrupted upgrade resumes where it stopped
+        if (nBatchBytes > nBatchSize) {
+            if (!db.WriteBatch(batch))
+                return error("%s : failed to write upgraded coins", __func__);
+            batch = CLevelDBBatch();
+            nBatchBytes = 0;
+        }
+        pcursor->Next();
+    }
+    if (!db.WriteBatch(batch, true))
+        return error("%s : failed to write upgraded coins", __func__);
+
+    LogPrintf("Upgraded %u transactions (%u unspent outputs) in the coin database\n", (unsigned int)nTransactions, (unsigned int)nOutputs);
+    return true;
+}
+
+CCoinsViewDBAsync::CCoinsViewDBAsync(CCoinsViewDB* dbIn) : db(dbIn), hashPending(0), fPending(false), fWriteFailed(false), fShutdown(false)
+{
+    threadWrite = boost::thread(boost::bind(&CCoinsViewDBAsync::ThreadWriteCoins, this));
+}
+
+CCoinsViewDBAsync::~CCoinsViewDBAsync()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fShutdown = true;
+        condWrite.notify_all();
+    }
+    // A queued batch is still written before the thread exits
+    threadWrite.join();
+}
+
+void CCoinsViewDBAsync::ThreadWriteCoins()
+{
+    RenameThread("aratriton-coinsflush");
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (true) {
+        while (!fPending && !fShutdown)
+            condWrite.wait(lock);
+        if (!fPending)
+            return;
+
+        // mapPending is not modified while fPending is set, so readers can keep using it
+        int64_t nStart = GetTimeMillis();
+        lock.unlock();
+        bool fOk = false;
+        try {
+            fOk = db->WriteCoins(mapPending, hashPending);
+        } catch (const std::exception& e) {
+            LogPrintf("%s : %s\n", __func__, e.what());
+        }
+        lock.lock();
+
+        if (fOk) {
+            LogPrint("coindb", "Background write of %u coin entries took %dms\n", (unsigned int)mapPending.size(), GetTimeMillis() - nStart);
+            mapPending.clear();
+        } else {
+            LogPrintf("ERROR: %s : failed to write to coin database\n", __func__);
+            fWriteFailed = true;
+        }
+        fPending = false;
+        condWrite.notify_all();
+    }
+}
+
+bool CCoinsViewDBAsync::GetCoins(const uint256& txid, CCoins& coins) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        CCoinsMap::const_iterator it = mapPending.find(txid);
+        if (it != mapPending.end()) {
+            coins = it->second.coins;
+            return true;
+        }
+    }
+    return db->GetCoins(txid, coins);
+}
+
+bool CCoinsViewDBAsync::HaveCoins(const uint256& txid) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        CCoinsMap::const_iterator it = mapPending.find(txid);
+        if (it != mapPending.end())
+            return !it->second.coins.IsPruned();
+    }
+    return db->HaveCoins(txid);
+}
+
+uint256 CCoinsViewDBAsync::GetBestBlock() const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if ((fPending || fWriteFailed) && hashPending != uint256(0))
+            return hashPending;
+    }
+    return db->GetBestBlock();
+}
+
+bool CCoinsViewDBAsync::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    // Only one batch is in flight; a flush arriving before it completes waits here
+    while (fPending)
+        condWrite.wait(lock);
+    if (fWriteFailed)
+        return false;
+
+    mapPending.swap(mapCoins);
+    for (CCoinsMap::iterator it = mapPending.begin(); it != mapPending.end();) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY)
+            it++;
+        else
+            mapPending.erase(it++);
+    }
+    mapCoins.clear();
+    hashPending = hashBlock;
+    fPending = true;
+    condWrite.notify_all();
+    return true;
+}
+
+bool CCoinsViewDBAsync::GetStats(CCoinsStats& stats) const
+{
+    if (!Sync())
+        return false;
+    return db->GetStats(stats);
+}
+
+bool CCoinsViewDBAsync::Sync() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (fPending)
+        condWrite.wait(lock);
+    return !fWriteFailed;
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
 {
 }
@@ -123,7 +456,9 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
-    pcursor->SeekToFirst();
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << CCoinsOutputKey();
+    pcursor->Seek(ssKeySet.str());
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = GetBestBlock();
@@ -132,35 +467,27 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
-            leveldb::Slice slKey = pcursor->key();
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
-            char chType;
-            ssKey >> chType;
-            if (chType == 'c') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CCoins coins;
-                ssValue >> coins;
-                uint256 txhash;
-                ssKey >> txhash;
-                ss << txhash;
-                ss << VARINT(coins.nVersion);
-                ss << (coins.fCoinBase ? 'c' : 'n');
-                ss << VARINT(coins.nHeight);
-                stats.nTransactions++;
-                for (unsigned int i = 0; i < coins.vout.size(); i++) {
-                    const CTxOut& out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i + 1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
+            uint256 txhash;
+            CCoins coins;
+            size_t nSize;
+            if (!ReadCoinsAtCursor(pcursor.get(), txhash, false, coins, nSize))
+                break;
+            ss << txhash;
+            ss << VARINT(coins.nVersion);
+            ss << (coins.fCoinBase ? 'c' : 'n');
+            ss << VARINT(coins.nHeight);
+            stats.nTransactions++;
+            for (unsigned int i = 0; i < coins.vout.size(); i++) {
+                const CTxOut& out = coins.vout[i];
+                if (!out.IsNull()) {
+                    stats.nTransactionOutputs++;
+                    ss << VARINT(i + 1);
+                    ss << out;
+                    nTotalAmount += out.nValue;
                 }
-                stats.nSerializedSize += 32 + slValue.size();
-                ss << VARINT(0);
             }
-            pcursor->Next();
+            stats.nSerializedSize += nSize;
+            ss << VARINT(0);
         } catch (std::exception& e) {
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
@@ -208,6 +535,51 @@ bool CBlockTreeDB::ReadInt(const std::string& name, int& nValue)
     return Read(std::make_pair('I', name), nValue);
 }
 
+bool CBlockTreeDB::WriteIndexSnapshotId(const uint256& id)
+{
+    return Write('X', id, true);
+}
+
+bool CBlockTreeDB::ReadIndexSnapshotId(uint256& id)
+{
+    return Read('X', id);
+}
+
+bool CBlockTreeDB::EraseIndexSnapshotId()
+{
+    return Erase('X', true);
+}
+
+namespace {
+/** Number of block index records that are deserialized together while loading */
+const size_t BLOCK_INDEX_LOAD_BATCH = 16384;
+
+/** A raw 'b' record, and its contents once deserialized */
+struct CBlockIndexRecord {
+    uint256 hash;
+    std::string strValue;
+    CDiskBlockIndex diskindex;
+    std::string strError;
+};
+
+void DeserializeBlockIndexRecords(std::vector<CBlockIndexRecord>& vRecords, size_t nBegin, size_t nEnd, bool fVerifyHash)
+{
+    for (size_t i = nBegin; i < nEnd; i++) {
+        CBlockIndexRecord& record = vRecords[i];
+        try {
+            CDataStream ssValue(record.strValue.data(), record.strValue.data() + record.strValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> record.diskindex;
+        } catch (std::exception& e) {
+            record.strError = strprintf("Deserialize or I/O error - %s", e.what());
+            continue;
+        }
+        if (fVerifyHash && record.diskindex.GetBlockHash() != record.hash)
+            record.strError = strprintf("block index entry %s hashes to %s", record.hash.ToString(), record.diskindex.GetBlockHash().ToString());
+        std::string().swap(record.strValue);
+    }
+}
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts()
 {
     boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
@@ -216,75 +588,104 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     ssKeySet << make_pair('b', uint256(0));
     pcursor->Seek(ssKeySet.str());
 
+    // The block hash is the key of each record, so it is not recomputed from the header
+    // (a Quark hash for pre-v4 blocks) unless -checkblockindex asks for it. Records are
+    // read in batches and deserialized on up to -par threads, then linked in key order.
+    const bool fVerifyHash = fCheckBlockIndex;
+    const int nThreads = std::max(nScriptCheckThreads, 1);
+    std::vector<CBlockIndexRecord> vRecords;
+    vRecords.reserve(BLOCK_INDEX_LOAD_BATCH);
+
     // Load mapBlockIndex
     uint256 nPreviousCheckpoint;
-    while (pcursor->Valid()) {
+    bool fDone = false;
+    while (!fDone) {
         boost::this_thread::interruption_point();
+
+        // Collect the next batch of raw records
+        vRecords.clear();
         try {
-            leveldb::Slice slKey = pcursor->key();
-            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
-            char chType;
-            ssKey >> chType;
-            if (chType == 'b') {
+            while (vRecords.size() < BLOCK_INDEX_LOAD_BATCH && pcursor->Valid()) {
+                leveldb::Slice slKey = pcursor->key();
+                CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                char chType;
+                ssKey >> chType;
+                if (chType != 'b')
+                    break; // finished loading block index
+                vRecords.push_back(CBlockIndexRecord());
+                CBlockIndexRecord& record = vRecords.back();
+                ssKey >> record.hash;
                 leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CDiskBlockIndex diskindex;
-                ssValue >> diskindex;
-
-                // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-
-                //zerocoin
-                pindexNew->nAccumulatorCheckpoint = diskindex.nAccumulatorCheckpoint;
-                pindexNew->mapZerocoinSupply = diskindex.mapZerocoinSupply;
-                pindexNew->vMintDenominationsInBlock = diskindex.vMintDenominationsInBlock;
-
-                //Proof Of Stake
-                pindexNew->nMint = diskindex.nMint;
-                pindexNew->nMoneySupply = diskindex.nMoneySupply;
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->nStakeModifier = diskindex.nStakeModifier;
-                pindexNew->prevoutStake = diskindex.prevoutStake;
-                pindexNew->nStakeTime = diskindex.nStakeTime;
-                pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
-
-                if (pindexNew->nHeight <= Params().LAST_POW_BLOCK()) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
-                        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
-                }
-                // ppcoin: build setStakeSeen
-                if (pindexNew->IsProofOfStake())
-                    setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
-
-                //populate accumulator checksum map in memory
-                if(pindexNew->nAccumulatorCheckpoint != 0 && pindexNew->nAccumulatorCheckpoint != nPreviousCheckpoint) {
-                    //Don't load any checkpoints that exist before v2 zara. The accumulator is invalid for v1 and not used.
-                    if (pindexNew->nHeight >= Params().Zerocoin_Block_V2_Start())
-                        LoadAccumulatorValuesFromDB(pindexNew->nAccumulatorCheckpoint);
-
-                    nPreviousCheckpoint = pindexNew->nAccumulatorCheckpoint;
-                }
-
+                record.strValue.assign(slValue.data(), slValue.size());
                 pcursor->Next();
-            } else {
-                break; // if shutdown requested or finished loading block index
             }
         } catch (std::exception& e) {
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
+        fDone = vRecords.size() < BLOCK_INDEX_LOAD_BATCH;
+
+        // Deserialize the batch
+        if (nThreads > 1 && vRecords.size() > 1) {
+            boost::thread_group threadGroup;
+            size_t nPerThread = (vRecords.size() + nThreads - 1) / nThreads;
+            for (size_t nBegin = 0; nBegin < vRecords.size(); nBegin += nPerThread)
+                threadGroup.create_thread(boost::bind(&DeserializeBlockIndexRecords, boost::ref(vRecords), nBegin, std::min(nBegin + nPerThread, vRecords.size()), fVerifyHash));
+            threadGroup.join_all();
+        } else {
+            DeserializeBlockIndexRecords(vRecords, 0, vRecords.size(), fVerifyHash);
+        }
+
+        for (const CBlockIndexRecord& record : vRecords) {
+            if (!record.strError.empty())
+                return error("%s : %s", __func__, record.strError);
+            const CDiskBlockIndex& diskindex = record.diskindex;
+
+            // Construct block index object
+            CBlockIndex* pindexNew = InsertBlockIndex(record.hash);
+            pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
+            pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nVersion = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+
+            //zerocoin
+            pindexNew->nAccumulatorCheckpoint = diskindex.nAccumulatorCheckpoint;
+            pindexNew->SetZerocoinSupply(&diskindex);
+            std::copy(diskindex.nMintsInBlock, diskindex.nMintsInBlock + libzerocoin::ZEROCOIN_DENOM_COUNT, pindexNew->nMintsInBlock);
+
+            //Proof Of Stake
+            pindexNew->nMint = diskindex.nMint;
+            pindexNew->nMoneySupply = diskindex.nMoneySupply;
+            pindexNew->nFlags = diskindex.nFlags;
+            pindexNew->nStakeModifier = diskindex.nStakeModifier;
+            pindexNew->prevoutStake = diskindex.prevoutStake;
+            pindexNew->nStakeTime = diskindex.nStakeTime;
+
+            if (pindexNew->nHeight <= Params().LAST_POW_BLOCK()) {
+                if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
+                    return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
+            }
+            // ppcoin: build setStakeSeen
+            if (pindexNew->IsProofOfStake())
+                setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+
+            //populate accumulator checksum map in memory
+            if(pindexNew->nAccumulatorCheckpoint != 0 && pindexNew->nAccumulatorCheckpoint != nPreviousCheckpoint) {
+                //Don't load any checkpoints that exist before v2 zara. The accumulator is invalid for v1 and not used.
+                if (pindexNew->nHeight >= Params().Zerocoin_Block_V2_Start())
+                    LoadAccumulatorValuesFromDB(pindexNew->nAccumulatorCheckpoint);
+
+                nPreviousCheckpoint = pindexNew->nAccumulatorCheckpoint;
+            }
+        }
     }
 
     return true;
@@ -365,6 +766,69 @@ bool CZerocoinDB::EraseCoinSpend(const CBigNum& bnSerial)
     return Erase(make_pair('s', hash));
 }
 
+bool CZerocoinDB::ReadCoinSpendTxids(std::vector<uint256>& vTxid)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('s', uint256(0));
+    pcursor->Seek(ssKeySet.str());
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 's')
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            uint256 txid;
+            ssValue >> txid;
+            vTxid.push_back(txid);
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+
+    return true;
+}
+
+bool CZerocoinDB::WriteSpendTxBatch(const std::vector<std::pair<uint256, uint256> >& vSpendTx)
+{
+    CLevelDBBatch batch;
+    for (const std::pair<uint256, uint256>& spendTx : vSpendTx)
+        batch.Write(make_pair('T', spendTx.first), spendTx.second);
+
+    return WriteBatch(batch, true);
+}
+
+bool CZerocoinDB::ReadSpendTx(const uint256& txid, uint256& hashBlock)
+{
+    return Read(make_pair('T', txid), hashBlock);
+}
+
+bool CZerocoinDB::EraseSpendTx(const uint256& txid)
+{
+    return Erase(make_pair('T', txid));
+}
+
+bool CZerocoinDB::WriteFlag(const std::string& name, bool fValue)
+{
+    return Write(std::make_pair('F', name), fValue ? '1' : '0');
+}
+
+bool CZerocoinDB::ReadFlag(const std::string& name, bool& fValue)
+{
+    char ch;
+    if (!Read(std::make_pair('F', name), ch))
+        return false;
+    fValue = ch == '1';
+    return true;
+}
+
 bool CZerocoinDB::WipeCoins(std::string strType)
 {
     if (strType != "spends" && strType != "mints")
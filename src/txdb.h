@@ -16,6 +16,8 @@
 #include <utility>
 #include <vector>
 
+#include <boost/thread.hpp>
+
 class CCoins;
 class uint256;
 
@@ -25,8 +27,14 @@ static const int64_t nDefaultDbCache = 100;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 4096 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! -asyncflush default
+static const bool DEFAULT_ASYNC_FLUSH = true;
 
-/** CCoinsView backed by the LevelDB coin database (chainstate/) */
+/**
+ * CCoinsView backed by the LevelDB coin database (chainstate/).
+ * Unspent outputs are stored one record per output, so spending a single
+ * output of a transaction only erases that output's record.
+ */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
@@ -40,6 +48,57 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
+
+    //! Write the dirty entries of mapCoins and the best block in one atomic batch, leaving mapCoins untouched
+    bool WriteCoins(const CCoinsMap& mapCoins, const uint256& hashBlock);
+
+    //! Convert a database with per-transaction records to per-output records (no-op if already converted)
+    bool Upgrade();
+};
+
+/**
+ * CCoinsView that writes flushed cache entries to a CCoinsViewDB on a background thread.
+ *
+ * BatchWrite only queues the dirty entries and returns, so the cache above it
+ * starts over empty while LevelDB does the work. Queued entries keep answering
+ * reads until they are on disk. The coins and the best block marker are still
+ * written in a single batch, so after a crash the database is consistent with
+ * the last batch that completed and the missing blocks are connected again.
+ */
+class CCoinsViewDBAsync : public CCoinsView
+{
+private:
+    CCoinsViewDB* db;
+
+    mutable boost::mutex cs;
+    mutable boost::condition_variable condWrite;
+
+    //! entries queued for, or being written to, the database
+    CCoinsMap mapPending;
+    //! best block of the queued entries
+    uint256 hashPending;
+    //! whether a batch is queued or being written
+    bool fPending;
+    //! whether a background write failed; the pending entries are then kept to answer reads
+    bool fWriteFailed;
+    bool fShutdown;
+
+    boost::thread threadWrite;
+
+    void ThreadWriteCoins();
+
+public:
+    CCoinsViewDBAsync(CCoinsViewDB* dbIn);
+    ~CCoinsViewDBAsync();
+
+    bool GetCoins(const uint256& txid, CCoins& coins) const;
+    bool HaveCoins(const uint256& txid) const;
+    uint256 GetBestBlock() const;
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
+    bool GetStats(CCoinsStats& stats) const;
+
+    //! Wait until queued entries are written; returns false if a background write failed
+    bool Sync() const;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -66,6 +125,9 @@ public:
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
     bool ReadInt(const std::string& name, int& nValue);
+    bool WriteIndexSnapshotId(const uint256& id);
+    bool ReadIndexSnapshotId(uint256& id);
+    bool EraseIndexSnapshotId();
     bool LoadBlockIndexGuts();
 };
 
@@ -90,6 +152,13 @@ public:
     bool ReadCoinSpend(const uint256& hashSerial, uint256 &txHash);
     bool EraseCoinMint(const CBigNum& bnPubcoin);
     bool EraseCoinSpend(const CBigNum& bnSerial);
+    bool ReadCoinSpendTxids(std::vector<uint256>& vTxid);
+    /** Index the txids of zARA spends by the hash of the block they are in */
+    bool WriteSpendTxBatch(const std::vector<std::pair<uint256, uint256> >& vSpendTx);
+    bool ReadSpendTx(const uint256& txid, uint256& hashBlock);
+    bool EraseSpendTx(const uint256& txid);
+    bool WriteFlag(const std::string& name, bool fValue);
+    bool ReadFlag(const std::string& name, bool& fValue);
     bool WipeCoins(std::string strType);
     bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
     bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
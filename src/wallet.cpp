@@ -694,6 +694,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
 
         // Break debit/credit balance caches:
         wtx.MarkDirty();
+        fStakeCandidatesDirty = true;
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -754,6 +755,7 @@ void CWallet::EraseFromWallet(const uint256& hash)
         LOCK(cs_wallet);
         if (mapWallet.erase(hash))
             CWalletDB(strWalletFile).EraseTx(hash);
+        fStakeCandidatesDirty = true;
     }
     return;
 }
@@ -2081,7 +2083,7 @@ bool less_then_denom(const COutput& out1, const COutput& out2)
     return (!found1 && found2);
 }
 
-bool CWallet::SelectStakeCoins(std::list<std::unique_ptr<CStakeInput> >& listInputs, CAmount nTargetAmount)
+bool CWallet::SelectStakeCoins(std::list<std::unique_ptr<CStakeInput> >& listInputs, CAmount nTargetAmount, int64_t* pnNextStakeTime)
 {
     LOCK(cs_main);
     //Add ARA
@@ -2103,8 +2105,11 @@ bool CWallet::SelectStakeCoins(std::list<std::unique_ptr<CStakeInput> >& listInp
             }
 
             //check for min age
-            if (GetAdjustedTime() - nTxTime < nStakeMinAge)
+            if (GetAdjustedTime() - nTxTime < nStakeMinAge) {
+                if (pnNextStakeTime)
+                    *pnNextStakeTime = std::min(*pnNextStakeTime, nTxTime + nStakeMinAge);
                 continue;
+            }
 
             //check that it is matured
             if (out.nDepth < (out.tx->IsCoinStake() ? Params().COINBASE_MATURITY() : 10))
@@ -2115,6 +2120,10 @@ bool CWallet::SelectStakeCoins(std::list<std::unique_ptr<CStakeInput> >& listInp
 
             std::unique_ptr<CAraStake> input(new CAraStake());
             input->SetInput((CTransaction) *out.tx, out.i);
+            // The wallet already knows the block, which saves a transaction lookup later on
+            BlockMap::iterator mi = mapBlockIndex.find(out.tx->hashBlock);
+            if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second))
+                input->SetIndexFrom(mi->second);
             listInputs.emplace_back(std::move(input));
         }
     }
@@ -2123,6 +2132,66 @@ bool CWallet::SelectStakeCoins(std::list<std::unique_ptr<CStakeInput> >& listInp
     return true;
 }
 
+std::shared_ptr<CStakeCandidateSet> CWallet::GetStakeCandidates()
+{
+    LOCK2(cs_main, cs_wallet);
+    int64_t nNow = GetAdjustedTime();
+    // A new tip changes depths, so outputs may have matured or been reorganized away
+    if (pStakeCandidates && !fStakeCandidatesDirty && nNow < pStakeCandidates->nRefreshTime &&
+        pStakeCandidates->hashTip == chainActive.Tip()->GetBlockHash() && pStakeCandidates->nReserveBalance == nReserveBalance)
+        return pStakeCandidates;
+
+    // Stake modifiers of outputs that were candidates before, by outpoint and the block they are in
+    std::map<std::string, std::pair<uint256, uint64_t> > mapModifiers;
+    if (pStakeCandidates) {
+        for (size_t i = 0; i < pStakeCandidates->vInputs.size(); i++) {
+            const CStakeKernelCandidate& kernel = pStakeCandidates->vKernels[i];
+            CBlockIndex* pindex = pStakeCandidates->vInputs[i]->GetIndexFrom();
+            if (pindex)
+                mapModifiers[kernel.ssUniqueID.str()] = std::make_pair(pindex->GetBlockHash(), kernel.nStakeModifier);
+        }
+    }
+
+    fStakeCandidatesDirty = false;
+    std::shared_ptr<CStakeCandidateSet> pset = std::make_shared<CStakeCandidateSet>();
+    pset->nBalance = GetBalance();
+    pset->nReserveBalance = nReserveBalance;
+    pset->hashTip = chainActive.Tip()->GetBlockHash();
+
+    std::list<std::unique_ptr<CStakeInput> > listInputs;
+    if (pset->nBalance > 0 && pset->nBalance > nReserveBalance)
+        SelectStakeCoins(listInputs, pset->nBalance - nReserveBalance, &pset->nRefreshTime);
+
+    for (std::unique_ptr<CStakeInput>& stakeInput : listInputs) {
+        CBlockIndex* pindex = stakeInput->GetIndexFrom();
+        if (!pindex || pindex->nHeight < 1)
+            continue;
+
+        unsigned int nTimeBlockFrom = pindex->GetBlockTime();
+        if (nTimeBlockFrom + nStakeMinAge > nNow) {
+            pset->nRefreshTime = std::min(pset->nRefreshTime, (int64_t)nTimeBlockFrom + nStakeMinAge);
+            continue; // Min age requirement
+        }
+
+        CDataStream ssUniqueID = stakeInput->GetUniqueness();
+        uint64_t nStakeModifier = 0;
+        std::map<std::string, std::pair<uint256, uint64_t> >::const_iterator it = mapModifiers.find(ssUniqueID.str());
+        if (it != mapModifiers.end() && it->second.first == pindex->GetBlockHash()) {
+            nStakeModifier = it->second.second;
+        } else if (!stakeInput->GetModifier(nStakeModifier)) {
+            LogPrint("staking", "%s : failed to get kernel stake modifier\n", __func__);
+            continue;
+        }
+
+        pset->vKernels.push_back(CStakeKernelCandidate(ssUniqueID, stakeInput->GetValue(), nStakeModifier, nTimeBlockFrom));
+        pset->vInputs.push_back(std::move(stakeInput));
+    }
+
+    LogPrint("staking", "%s : %u stake candidates, balance %s\n", __func__, pset->vInputs.size(), FormatMoney(pset->nBalance));
+    pStakeCandidates = pset;
+    return pStakeCandidates;
+}
+
 bool CWallet::MintableCoins()
 {
     LOCK(cs_main);
@@ -2919,116 +2988,86 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
     scriptEmpty.clear();
     txNew.vout.push_back(CTxOut(0, scriptEmpty));
 
-    // Choose coins to use
-    CAmount nBalance = GetBalance();
-
     if (mapArgs.count("-reservebalance") && !ParseMoney(mapArgs["-reservebalance"], nReserveBalance))
         return error("CreateCoinStake : invalid reserve balance amount");
 
-    if (nBalance > 0 && nBalance <= nReserveBalance)
+    // Get the stakable inputs, with what their kernel hashes need worked out already
+    std::shared_ptr<CStakeCandidateSet> pcandidates = GetStakeCandidates();
+    if (pcandidates->nBalance > 0 && pcandidates->nBalance <= nReserveBalance)
         return false;
 
-    // Get the list of stakable inputs
-    std::list<std::unique_ptr<CStakeInput> > listInputs;
-    if (!SelectStakeCoins(listInputs, nBalance - nReserveBalance))
+    if (pcandidates->vKernels.empty())
         return false;
 
-    if (listInputs.empty())
+    // Make sure the wallet is unlocked and shutdown hasn't been requested
+    if (IsLocked() || ShutdownRequested())
         return false;
 
-    if (GetAdjustedTime() - chainActive.Tip()->GetBlockTime() < 60)
-        MilliSleep(10000);
+    nTxNewTime = GetAdjustedTime();
+    uint256 hashProofOfStake = 0;
+    size_t nKernel = 0;
+    bool fKernelFound = SearchStakeKernels(pcandidates->vKernels, nBits, nTxNewTime, nKernel, hashProofOfStake);
+    mapHashedBlocks.clear();
+    mapHashedBlocks[chainActive.Tip()->nHeight] = GetTime(); //store a time stamp of when we last hashed on this block
+    if (!fKernelFound)
+        return false;
+    CStakeInput* stakeInput = pcandidates->vInputs[nKernel].get();
 
     CAmount nCredit = 0;
-    CScript scriptPubKeyKernel;
-    bool fKernelFound = false;
-    for (std::unique_ptr<CStakeInput>& stakeInput : listInputs) {
-        // Make sure the wallet is unlocked and shutdown hasn't been requested
-        if (IsLocked() || ShutdownRequested())
+    {
+        LOCK(cs_main);
+        //Double check that this will pass time requirements
+        if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
+            LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
             return false;
-
-        //make sure that enough time has elapsed between
-        CBlockIndex* pindex = stakeInput->GetIndexFrom();
-        if (!pindex || pindex->nHeight < 1) {
-            LogPrintf("*** no pindexfrom\n");
-            continue;
         }
 
-        // Read block header
-        CBlockHeader block = pindex->GetBlockHeader();
-        uint256 hashProofOfStake = 0;
-        nTxNewTime = GetAdjustedTime();
+        // Found a kernel
+        LogPrintf("CreateCoinStake : kernel found\n");
+        nCredit += stakeInput->GetValue();
 
-        //iterates each utxo inside of CheckStakeKernelHash()
-        if (Stake(stakeInput.get(), nBits, block.GetBlockTime(), nTxNewTime, hashProofOfStake)) {
-            LOCK(cs_main);
-            //Double check that this will pass time requirements
-            if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
-                LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
-                continue;
-            }
-
-            // Found a kernel
-            LogPrintf("CreateCoinStake : kernel found\n");
-            nCredit += stakeInput->GetValue();
-
-            // Calculate reward
-            CAmount nReward;
-            nReward = GetBlockValue(chainActive.Height() + 1);
-            nCredit += nReward;
+        // Calculate reward
+        CAmount nReward;
+        nReward = GetBlockValue(chainActive.Height() + 1);
+        nCredit += nReward;
 
-            // Create the output transaction(s)
-            vector<CTxOut> vout;
-            if (!stakeInput->CreateTxOuts(this, vout, nCredit)) {
-                LogPrintf("%s : failed to get scriptPubKey\n", __func__);
-                continue;
-            }
-            txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
-
-            CAmount nMinFee = 0;
-            if (!stakeInput->IsZARA()) {
-                // Set output amount
-                if (txNew.vout.size() == 3) {
-                    txNew.vout[1].nValue = ((nCredit - nMinFee) / 2 / CENT) * CENT;
-                    txNew.vout[2].nValue = nCredit - nMinFee - txNew.vout[1].nValue;
-                } else
-                    txNew.vout[1].nValue = nCredit - nMinFee;
-            }
+        // Create the output transaction(s)
+        vector<CTxOut> vout;
+        if (!stakeInput->CreateTxOuts(this, vout, nCredit))
+            return error("%s : failed to get scriptPubKey", __func__);
+        txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
 
-            // Limit size
-            unsigned int nBytes = ::GetSerializeSize(txNew, SER_NETWORK, PROTOCOL_VERSION);
-            if (nBytes >= DEFAULT_BLOCK_MAX_SIZE / 5)
-                return error("CreateCoinStake : exceeded coinstake size limit");
+        CAmount nMinFee = 0;
+        if (!stakeInput->IsZARA()) {
+            // Set output amount
+            if (txNew.vout.size() == 3) {
+                txNew.vout[1].nValue = ((nCredit - nMinFee) / 2 / CENT) * CENT;
+                txNew.vout[2].nValue = nCredit - nMinFee - txNew.vout[1].nValue;
+            } else
+                txNew.vout[1].nValue = nCredit - nMinFee;
+        }
 
-            //Masternode payment
-            FillBlockPayee(txNew, nMinFee, true, stakeInput->IsZARA());
+        // Limit size
+        unsigned int nBytes = ::GetSerializeSize(txNew, SER_NETWORK, PROTOCOL_VERSION);
+        if (nBytes >= DEFAULT_BLOCK_MAX_SIZE / 5)
+            return error("CreateCoinStake : exceeded coinstake size limit");
 
-            uint256 hashTxOut = txNew.GetHash();
-            CTxIn in;
-            if (!stakeInput->CreateTxIn(this, in, hashTxOut)) {
-                LogPrintf("%s : failed to create TxIn\n", __func__);
-                txNew.vin.clear();
-                txNew.vout.clear();
-                nCredit = 0;
-                continue;
-            }
-            txNew.vin.emplace_back(in);
+        //Masternode payment
+        FillBlockPayee(txNew, nMinFee, true, stakeInput->IsZARA());
 
-            //Mark mints as spent
-            if (stakeInput->IsZARA()) {
-                CZAraStake* z = (CZAraStake*)stakeInput.get();
-                if (!z->MarkSpent(this, txNew.GetHash()))
-                    return error("%s: failed to mark mint as used\n", __func__);
-            }
+        uint256 hashTxOut = txNew.GetHash();
+        CTxIn in;
+        if (!stakeInput->CreateTxIn(this, in, hashTxOut))
+            return error("%s : failed to create TxIn", __func__);
+        txNew.vin.emplace_back(in);
 
-            fKernelFound = true;
-            break;
+        //Mark mints as spent
+        if (stakeInput->IsZARA()) {
+            CZAraStake* z = (CZAraStake*)stakeInput;
+            if (!z->MarkSpent(this, txNew.GetHash()))
+                return error("%s: failed to mark mint as used\n", __func__);
         }
-        if (fKernelFound)
-            break; // if kernel is found stop searching
     }
-    if (!fKernelFound)
-        return false;
 
     // Sign for ARA
     int nIn = 0;
@@ -3740,18 +3779,21 @@ void CWallet::LockCoin(COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.insert(output);
+    fStakeCandidatesDirty = true;
 }
 
 void CWallet::UnlockCoin(COutPoint& output)
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.erase(output);
+    fStakeCandidatesDirty = true;
 }
 
 void CWallet::UnlockAllCoins()
 {
     AssertLockHeld(cs_wallet); // setLockedCoins
     setLockedCoins.clear();
+    fStakeCandidatesDirty = true;
 }
 
 bool CWallet::IsLockedCoin(uint256 hash, unsigned int n) const
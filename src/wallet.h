@@ -28,7 +28,10 @@
 #include "zaratracker.h"
 
 #include <algorithm>
+#include <atomic>
+#include <limits>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdexcept>
 #include <stdint.h>
@@ -159,6 +162,21 @@ public:
     StringMap destdata;
 };
 
+/**
+ * The outputs of a wallet that can stake right now, each with what its kernel
+ * hash needs already worked out, so that a staking pass only hashes.
+ */
+struct CStakeCandidateSet {
+    std::vector<std::unique_ptr<CStakeInput> > vInputs;
+    std::vector<CStakeKernelCandidate> vKernels; //! same order as vInputs
+    CAmount nBalance;                            //! GetBalance() when the set was built
+    CAmount nReserveBalance;                     //! -reservebalance the set was built for
+    uint256 hashTip;                             //! chain tip the set was built at
+    int64_t nRefreshTime;                        //! an output that was too young becomes old enough to stake
+
+    CStakeCandidateSet() : nBalance(0), nReserveBalance(0), nRefreshTime(std::numeric_limits<int64_t>::max()) {}
+};
+
 /**
  * A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
@@ -192,9 +210,18 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    //! Stake candidates, rebuilt by GetStakeCandidates() after wallet or chain changes
+    std::shared_ptr<CStakeCandidateSet> pStakeCandidates;
+    std::atomic<bool> fStakeCandidatesDirty;
+
 public:
     bool MintableCoins();
-    bool SelectStakeCoins(std::list<std::unique_ptr<CStakeInput> >& listInputs, CAmount nTargetAmount);
+    bool SelectStakeCoins(std::list<std::unique_ptr<CStakeInput> >& listInputs, CAmount nTargetAmount, int64_t* pnNextStakeTime = NULL);
+    /** The current stake candidate set; only rebuilt when the wallet, the chain tip or -reservebalance
+     *  changed, or when an output got old enough to stake */
+    std::shared_ptr<CStakeCandidateSet> GetStakeCandidates();
+    /** The balance the stake candidates were selected against */
+    CAmount GetStakingBalance() { return GetStakeCandidates()->nBalance; }
     bool SelectCoinsDark(CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet, int nObfuscationRoundsMin, int nObfuscationRoundsMax) const;
     bool SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& vCoinsRet, std::vector<COutput>& vCoinsRet2, CAmount& nValueRet, int nObfuscationRoundsMin, int nObfuscationRoundsMax);
     bool SelectCoinsDarkDenominated(CAmount nTargetValue, std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet) const;
@@ -309,6 +336,7 @@ public:
         nStakeSplitThreshold = 45;
         nHashInterval = 22;
         nStakeSetUpdateTime = 300; // 5 minutes
+        fStakeCandidatesDirty = true;
 
         //MultiSend
         vMultiSend.clear();
@@ -216,6 +216,28 @@ bool GetZerocoinMint(const CBigNum& bnPubcoin, uint256& txHash)
     return zerocoinDB->ReadCoinMint(bnPubcoin, txHash);
 }
 
+std::string IndexZerocoinSpendTxs()
+{
+    // Spends recorded by versions without the spend txid index are looked up through the txindex once
+    std::vector<uint256> vTxid;
+    if (!zerocoinDB->ReadCoinSpendTxids(vTxid))
+        return _("Failed to read zerocoin spends");
+
+    LOCK(cs_main);
+    std::vector<std::pair<uint256, uint256> > vSpendTx;
+    for (const uint256& txid : vTxid) {
+        int nHeightTx = 0;
+        if (IsTransactionInChain(txid, nHeightTx))
+            vSpendTx.push_back(make_pair(txid, chainActive[nHeightTx]->GetBlockHash()));
+    }
+
+    if (!zerocoinDB->WriteSpendTxBatch(vSpendTx) || !zerocoinDB->WriteFlag("spendtxindex", true))
+        return _("Error writing zerocoinDB to disk");
+
+    LogPrintf("%s: indexed %u zerocoin spend transactions\n", __func__, vSpendTx.size());
+    return "";
+}
+
 bool IsPubcoinInBlockchain(const uint256& hashPubcoin, uint256& txid)
 {
     txid = 0;
@@ -254,6 +276,20 @@ bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& tx
     return IsTransactionInChain(txidSpend, nHeightTx, tx);
 }
 
+bool IsSpendTxInBlockchain(const uint256& txid, int& nHeightTx)
+{
+    uint256 hashBlock;
+    if (!zerocoinDB->ReadSpendTx(txid, hashBlock))
+        return false;
+
+    BlockMap::const_iterator mi = mapBlockIndex.find(hashBlock);
+    if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second))
+        return false;
+
+    nHeightTx = mi->second->nHeight;
+    return true;
+}
+
 std::string ReindexZerocoinDB()
 {
     if (!zerocoinDB->WipeCoins("spends") || !zerocoinDB->WipeCoins("mints")) {
@@ -265,6 +301,7 @@ std::string ReindexZerocoinDB()
     CBlockIndex* pindex = chainActive[Params().Zerocoin_StartHeight()];
     std::vector<std::pair<libzerocoin::CoinSpend, uint256> > vSpendInfo;
     std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintInfo;
+    std::vector<std::pair<uint256, uint256> > vSpendTx;
     while (pindex) {
         uiInterface.ShowProgress(_("Reindexing zerocoin database..."), std::max(1, std::min(99, (int)((double)(pindex->nHeight - Params().Zerocoin_StartHeight()) / (double)(chainActive.Height() - Params().Zerocoin_StartHeight()) * 100))));
 
@@ -285,6 +322,7 @@ std::string ReindexZerocoinDB()
                     uint256 txid = tx.GetHash();
                     //Record Serials
                     if (tx.IsZerocoinSpend()) {
+                        vSpendTx.push_back(make_pair(txid, pindex->GetBlockHash()));
                         for (auto& in : tx.vin) {
                             if (!in.scriptSig.IsZerocoinSpend())
                                 continue;
@@ -312,10 +350,12 @@ std::string ReindexZerocoinDB()
 
         // Flush the zerocoinDB to disk every 100 blocks
         if (pindex->nHeight % 100 == 0) {
-            if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
+            if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)) ||
+                (!vSpendTx.empty() && !zerocoinDB->WriteSpendTxBatch(vSpendTx)))
                 return _("Error writing zerocoinDB to disk");
             vSpendInfo.clear();
             vMintInfo.clear();
+            vSpendTx.clear();
         }
 
         pindex = chainActive.Next(pindex);
@@ -323,7 +363,8 @@ std::string ReindexZerocoinDB()
     uiInterface.ShowProgress("", 100);
 
     // Final flush to disk in case any remaining information exists
-    if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
+    if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)) ||
+        (!vSpendTx.empty() && !zerocoinDB->WriteSpendTxBatch(vSpendTx)))
         return _("Error writing zerocoinDB to disk");
 
     uiInterface.ShowProgress("", 100);